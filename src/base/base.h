@@ -18,7 +18,9 @@
 
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <stdint.h>
+#include <vector>
 #include <glog/logging.h>
 #include <google/protobuf/stubs/status.h>
 
@@ -26,7 +28,57 @@ using namespace std;
 using google::protobuf::util::Status;
 using namespace google::protobuf::util;
 
-typedef function<float(int)> FloatVector;
+// Weight policies for the hot loops. UnitWeights lets the compiler drop the
+// multiply altogether when there is no weight column. See FloatVector::Visit.
+struct UnitWeights {
+  inline float operator()(int) const { return 1.0f; }
+  template <typename T>
+  inline const T& Apply(int, const T& value) const { return value; }
+};
+
+struct ArrayWeights {
+  inline float operator()(int i) const { return data[i]; }
+  template <typename T>
+  inline T Apply(int i, const T& value) const { return value * data[i]; }
+  const float* data;
+};
+
+// FloatVector is a read-only view of per-row floats such as sample weights and
+// targets. It either points into existing storage (e.g. the raw floats of a
+// RawFloatColumn), owns its floats, or represents unit values if default
+// constructed.
+class FloatVector {
+ public:
+  FloatVector() {}
+  // The floats must outlive the FloatVector.
+  FloatVector(const vector<float>& floats)
+      : data_(floats.data()), size_(floats.size()) {}
+  FloatVector(vector<float>&& floats)
+      : owned_(make_shared<const vector<float>>(std::move(floats))),
+        data_(owned_->data()), size_(owned_->size()) {}
+
+  inline float operator()(int i) const {
+    return data_ ? data_[i] : 1.0f;
+  }
+
+  // Whether every row reads 1.
+  inline bool unit() const { return data_ == nullptr; }
+  inline const float* data() const { return data_; }
+  inline size_t size() const { return size_; }
+
+  // Calls f with UnitWeights or ArrayWeights so that the caller's loop is
+  // compiled for each case.
+  template <typename Func>
+  inline auto Visit(Func&& f) const -> decltype(f(UnitWeights())) {
+    if (unit()) return f(UnitWeights());
+    return f(ArrayWeights{data_});
+  }
+
+ private:
+  shared_ptr<const vector<float>> owned_;
+  const float* data_ = nullptr;
+  size_t size_ = 0;
+};
 
 // Integer types
 typedef int8_t int8;
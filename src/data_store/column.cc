@@ -27,6 +27,8 @@ namespace gbdt {
 
 using namespace std::placeholders;
 
+constexpr double IntegerizedColumn::kMaxSparseDensity;
+
 namespace {
 
 const long kMaxUInt8 = 256;
@@ -130,6 +132,23 @@ void IntegerizedColumn::Finalize() {
   } else if (col_16_.size() > 0) {
     col_.reset(new IntegerCol16(&col_16_));
   }
+  BuildSparseIndex();
+}
+
+void IntegerizedColumn::BuildSparseIndex() {
+  VisitRawCol([this](const auto& col) {
+      size_t num_non_missing = col.size() - std::count(col.begin(), col.end(), 0);
+      sparse_ = col.size() > 0 && num_non_missing <= kMaxSparseDensity * col.size();
+      if (!sparse_) return;
+      sparse_rows_.reserve(num_non_missing);
+      sparse_values_.reserve(num_non_missing);
+      for (uint i = 0; i < col.size(); ++i) {
+        if (col[i] != 0) {
+          sparse_rows_.push_back(i);
+          sparse_values_.push_back(col[i]);
+        }
+      }
+    });
 }
 
 uint IntegerizedColumn::size() const {
@@ -16,6 +16,7 @@
 #ifndef COLUMN_H_
 #define COLUMN_H_
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <memory>
@@ -86,10 +87,41 @@ class IntegerizedColumn : public Column {
     return *col_;
   }
 
+  // Calls f with the raw storage of the column, which is one of vector<uint8>,
+  // vector<uint16> or vector<uint32> depending on max_int. Hot loops use it to
+  // be compiled for each integer type instead of calling the virtual
+  // IntegerCol::operator[] per element.
+  template <typename Func>
+  inline auto VisitRawCol(Func&& f) const -> decltype(f(vector<uint32>())) {
+    if (!col_8_.empty()) return f(col_8_);
+    if (!col_16_.empty()) return f(col_16_);
+    return f(col_32_);
+  }
+
+  // A column is sparse if at most kMaxSparseDensity of its rows are non-missing.
+  // Sparse columns also keep the non-missing rows in ascending order and their
+  // values, so that the work on them can be proportional to the number of
+  // non-missing rows.
+  static constexpr double kMaxSparseDensity = 0.1;
+  inline bool sparse() const {
+    return sparse_;
+  }
+  inline const vector<uint>& sparse_rows() const {
+    return sparse_rows_;
+  }
+  inline const vector<uint>& sparse_values() const {
+    return sparse_values_;
+  }
+
  protected:
   IntegerizedColumn(const string& name, ColumnType type) : Column(name, type) {}
 
+  void BuildSparseIndex();
+
   bool finalized_ = false;
+  bool sparse_ = false;
+  vector<uint> sparse_rows_;
+  vector<uint> sparse_values_;
   unique_ptr<IntegerCol> col_;
   // Depending on the number of unique string, the strings are either
   // encoded as 8 bit, 16 bit or 32 bit. The maximum we support is 32 bit.
@@ -153,6 +185,12 @@ class BucketizedFloatColumn : public IntegerizedColumn {
   inline float get_bucket_min(uint bucket_index) const {
     return bucket_mins_[bucket_index];
   }
+  // Returns the first bucket whose max is not less than the threshold. A non-missing
+  // bucket has a max less than the threshold iff it is below the returned bucket.
+  inline uint get_bucket_threshold(float threshold) const {
+    return std::lower_bound(bucket_maxs_.begin() + 1, bucket_maxs_.end(), threshold) -
+        bucket_maxs_.begin();
+  }
 
   // max_int is num_buckets + 1. All values exceeding the max upper bound are
   // put in the bin #bins_.size().
@@ -61,6 +61,14 @@ class StringColumnTest : public ::testing::Test {
       EXPECT_TRUE(string_column->get_cat_index(raw_strings[i], &cat_index));
       EXPECT_EQ(string_column->col()[i], cat_index);
     }
+    // The raw storage uses the narrowest integer type and matches col().
+    string_column->VisitRawCol([&](const auto& col) {
+        EXPECT_EQ(k + 1 <= 256 ? 1 : 2, sizeof(col[0]));
+        ASSERT_EQ(n, col.size());
+        for (int i = 0; i < n; ++i) {
+          EXPECT_EQ(string_column->col()[i], col[i]) << " at " << i;
+        }
+      });
   }
 };
 
@@ -279,6 +287,32 @@ TEST_F(FloatColumnTest, TestMissingFloats) {
   EXPECT_FALSE(NAN >= 0.2);
 }
 
+TEST_F(FloatColumnTest, TestSparseColumn) {
+  vector<float> raw_floats(100, NAN);
+  raw_floats[3] = 1;
+  raw_floats[50] = 2;
+  raw_floats[97] = 1;
+  auto column = Column::CreateBucketizedFloatColumn("foo", raw_floats, 10);
+  const auto* float_column = static_cast<const BucketizedFloatColumn*>(column.get());
+  ASSERT_TRUE(float_column->sparse());
+  EXPECT_EQ(vector<uint>({3, 50, 97}), float_column->sparse_rows());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(float_column->col()[float_column->sparse_rows()[i]],
+              float_column->sparse_values()[i]);
+  }
+
+  raw_floats[10] = 3;
+  raw_floats[20] = 3;
+  raw_floats[30] = 4;
+  raw_floats[40] = 4;
+  raw_floats[60] = 5;
+  raw_floats[70] = 5;
+  raw_floats[80] = 6;
+  raw_floats[90] = 6;
+  column = Column::CreateBucketizedFloatColumn("foo", raw_floats, 10);
+  EXPECT_FALSE(static_cast<const BucketizedFloatColumn*>(column.get())->sparse());
+}
+
 TEST_F(FloatColumnTest, TestRawFloats) {
   vector<float> raw_floats = GenerateRandomFloatVector(10000, 10000);
   auto raw_floats_copy = raw_floats;
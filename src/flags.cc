@@ -27,3 +27,30 @@ DEFINE_string(config_file, "", "The config file.");
 DEFINE_int32(num_threads, 16, "The number of threads.");
 DEFINE_string(mode, "train", "The running mode.");
 DEFINE_int32(seed, 1234567, "The random seed.");
+DEFINE_int32(histogram_cache_mb, 2048,
+             "The memory budget in MB for keeping the histograms of nodes waiting to be expanded.");
+DEFINE_bool(bin_matrix, false,
+            "Whether to keep a row-major copy of the features so that the histograms of a block "
+            "of features are computed in one pass over the samples.");
+DEFINE_int32(bin_matrix_block_kb, 256,
+             "The memory budget in KB for the histograms of a block of features in the bin matrix.");
+DEFINE_int32(histogram_arena_mb, 256,
+             "The memory budget in MB for the free histogram buffers kept by each thread for reuse.");
+DEFINE_bool(compact_gradients, false,
+            "Whether to keep the weighted gradients of the samples in single precision while "
+            "growing a tree, which halves the memory read per sample. Sums are still "
+            "accumulated in double precision.");
+DEFINE_bool(sparse_columns, true,
+            "Whether to compute the histograms and partitions of mostly-missing features from "
+            "their non-missing rows.");
+DEFINE_bool(simd_histograms, true,
+            "Whether to accumulate the histograms with the AVX2 kernel when the CPU supports it. "
+            "The scalar kernel computes the same histograms.");
+DEFINE_bool(quick_scorer, false,
+            "Whether to evaluate forests whose trees have at most 64 leaves with QuickScorer, "
+            "which finds the leaves of a row from the splits sorted by feature and threshold "
+            "instead of walking the trees. The scores are the same.");
+DEFINE_bool(simd_scoring, true,
+            "Whether to take rows through the trees of a compiled forest 8 at a time with the "
+            "AVX2 kernel when the CPU supports it, for the trees whose rows end at leaves of "
+            "similar depths. The scores are the same.");
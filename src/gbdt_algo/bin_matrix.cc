@@ -0,0 +1,219 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bin_matrix.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <limits>
+
+#include "histogram_arena.h"
+#include "src/data_store/column.h"
+#include "src/utils/threadpool.h"
+
+DECLARE_int32(num_threads);
+
+namespace gbdt {
+
+namespace {
+
+const uint kMaxUInt8 = numeric_limits<uint8>::max() + 1;
+const uint kMaxUInt16 = numeric_limits<uint16>::max() + 1;
+
+// Copies a column into its slot of the row-major bins.
+template <typename INT, typename COL>
+void TransposeColumn(const vector<COL>& col, int width, int offset, vector<INT>* bins) {
+  for (size_t i = 0; i < col.size(); ++i) {
+    (*bins)[i * width + offset] = col[i];
+  }
+}
+
+// Accumulates the weighted gradients of the samples into the histograms of the
+// features at the offsets of a block. It is compiled for each integer type of the
+// bins and each storage type of the gradients.
+template <typename INT, typename GRADIENT>
+void AccumulateBlockHistograms(const vector<INT>& bins,
+                               int width,
+                               const vector<int>& offsets,
+                               const VectorSlice<uint>& samples,
+                               const VectorSlice<GRADIENT>& ordered_gradients,
+                               const vector<GradientData*>& histograms) {
+  const int num_features = offsets.size();
+  auto gradient_it = ordered_gradients.begin();
+  for (auto index : samples) {
+    const GradientData gradient_data = *gradient_it++;
+    const INT* row = bins.data() + static_cast<size_t>(index) * width;
+    for (int j = 0; j < num_features; ++j) {
+      histograms[j][row[offsets[j]]] += gradient_data;
+    }
+  }
+}
+
+}  // namespace
+
+BinMatrix::BinMatrix(const vector<const Column*>& features, size_t block_bytes,
+                     int min_num_blocks) {
+  block_of_.resize(features.size(), -1);
+  offset_of_.resize(features.size(), -1);
+
+  // Features are bundled separately by the width of their bins.
+  vector<uint> features_8;
+  vector<uint> features_16;
+  for (uint i = 0; i < features.size(); ++i) {
+    if (features[i]->type() != Column::kStringColumn &&
+        features[i]->type() != Column::kBucketizedFloatColumn) {
+      continue;
+    }
+    const auto* feature = static_cast<const IntegerizedColumn*>(features[i]);
+    num_rows_ = feature->size();
+    if (feature->max_int() <= kMaxUInt8) {
+      features_8.push_back(i);
+    } else if (feature->max_int() <= kMaxUInt16) {
+      features_16.push_back(i);
+    }
+  }
+
+  int num_bundled = features_8.size() + features_16.size();
+  int max_width = max(1, (num_bundled + max(min_num_blocks, 1) - 1) / max(min_num_blocks, 1));
+  for (const auto* feature_list : {&features_8, &features_16}) {
+    size_t bytes = 0;
+    int width = max_width;  // Starts a new block for each list.
+    for (auto i : *feature_list) {
+      uint max_int = static_cast<const IntegerizedColumn*>(features[i])->max_int();
+      size_t histogram_bytes = max_int * sizeof(GradientData);
+      if (width >= max_width || (width > 0 && bytes + histogram_bytes > block_bytes)) {
+        blocks_.emplace_back();
+        bytes = 0;
+        width = 0;
+      }
+      auto& block = blocks_.back();
+      block_of_[i] = blocks_.size() - 1;
+      offset_of_[i] = block.features.size();
+      block.features.push_back(i);
+      block.max_ints.push_back(max_int);
+      bytes += histogram_bytes;
+      ++width;
+    }
+  }
+
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(blocks_.size(), [&](int i) {
+      FillBlock(features, &blocks_[i]);
+    });
+  LOG(INFO) << "Bundled " << num_bundled << " features into " << blocks_.size()
+            << " blocks of " << (memory_size() >> 20) << " MB.";
+}
+
+void BinMatrix::FillBlock(const vector<const Column*>& features, Block* block) {
+  int width = block->features.size();
+  bool use_8_bits = *max_element(block->max_ints.begin(), block->max_ints.end()) <= kMaxUInt8;
+  if (use_8_bits) {
+    block->bins_8.resize(static_cast<size_t>(num_rows_) * width);
+  } else {
+    block->bins_16.resize(static_cast<size_t>(num_rows_) * width);
+  }
+  for (int j = 0; j < width; ++j) {
+    const auto* feature = static_cast<const IntegerizedColumn*>(features[block->features[j]]);
+    feature->VisitRawCol([&](const auto& col) {
+        if (use_8_bits) {
+          TransposeColumn(col, width, j, &block->bins_8);
+        } else {
+          TransposeColumn(col, width, j, &block->bins_16);
+        }
+      });
+  }
+}
+
+void BinMatrix::ComputeHistograms(int block_index,
+                                  const vector<uint>& feature_indices,
+                                  const VectorSlice<uint>& samples,
+                                  const VectorSlice<GradientData>& ordered_gradients,
+                                  vector<vector<GradientData>>* histograms) const {
+  ComputeBlockHistograms(block_index, feature_indices, samples, ordered_gradients, histograms);
+}
+
+void BinMatrix::ComputeHistograms(int block_index,
+                                  const vector<uint>& feature_indices,
+                                  const VectorSlice<uint>& samples,
+                                  const VectorSlice<CompactGradientData>& ordered_gradients,
+                                  vector<vector<GradientData>>* histograms) const {
+  ComputeBlockHistograms(block_index, feature_indices, samples, ordered_gradients, histograms);
+}
+
+template <typename INT>
+void BinMatrix::ComputeHistograms(int block_index,
+                                  const vector<uint>& feature_indices,
+                                  const VectorSlice<uint>& samples,
+                                  const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+                                  const GradientData& scale,
+                                  vector<vector<GradientData>>* histograms) const {
+  // The sums in units of the scale are integers and exact in double, so they
+  // are rescaled to the same histograms as Histogram computes from the column.
+  ComputeBlockHistograms(block_index, feature_indices, samples, ordered_gradients, histograms);
+  for (auto& histogram : *histograms) {
+    for (auto& gradient_data : histogram) {
+      gradient_data.g *= scale.g;
+      gradient_data.h *= scale.h;
+    }
+  }
+}
+
+template void BinMatrix::ComputeHistograms(
+    int block_index, const vector<uint>& feature_indices, const VectorSlice<uint>& samples,
+    const VectorSlice<QuantizedGradientData<int8>>& ordered_gradients, const GradientData& scale,
+    vector<vector<GradientData>>* histograms) const;
+template void BinMatrix::ComputeHistograms(
+    int block_index, const vector<uint>& feature_indices, const VectorSlice<uint>& samples,
+    const VectorSlice<QuantizedGradientData<int16>>& ordered_gradients, const GradientData& scale,
+    vector<vector<GradientData>>* histograms) const;
+
+template <typename GRADIENT>
+void BinMatrix::ComputeBlockHistograms(int block_index,
+                                       const vector<uint>& feature_indices,
+                                       const VectorSlice<uint>& samples,
+                                       const VectorSlice<GRADIENT>& ordered_gradients,
+                                       vector<vector<GradientData>>* histograms) const {
+  const auto& block = blocks_[block_index];
+  vector<int> offsets(feature_indices.size());
+  vector<GradientData*> histogram_data(feature_indices.size());
+  histograms->resize(feature_indices.size());
+  for (int j = 0; j < feature_indices.size(); ++j) {
+    auto i = feature_indices[j];
+    CHECK_EQ(block_index, block_of_[i]) << "Feature " << i << " is not in block " << block_index;
+    offsets[j] = offset_of_[i];
+    (*histograms)[j] = HistogramArena::Get()->AllocateHistogram(block.max_ints[offsets[j]]);
+    histogram_data[j] = (*histograms)[j].data();
+  }
+
+  int width = block.features.size();
+  if (!block.bins_8.empty()) {
+    AccumulateBlockHistograms(block.bins_8, width, offsets, samples, ordered_gradients,
+                              histogram_data);
+  } else {
+    AccumulateBlockHistograms(block.bins_16, width, offsets, samples, ordered_gradients,
+                              histogram_data);
+  }
+}
+
+size_t BinMatrix::memory_size() const {
+  size_t size = 0;
+  for (const auto& block : blocks_) {
+    size += block.bins_8.capacity() * sizeof(uint8) + block.bins_16.capacity() * sizeof(uint16);
+  }
+  return size;
+}
+
+}  // namespace gbdt
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BIN_MATRIX_H_
+#define BIN_MATRIX_H_
+
+#include <vector>
+
+#include "src/base/base.h"
+#include "src/loss_func/gradient_data.h"
+#include "src/utils/vector_slice.h"
+
+namespace gbdt {
+
+class Column;
+
+// BinMatrix keeps a row-major copy of the integerized features, grouped into
+// blocks of features whose histograms fit in cache. One pass over the samples of
+// a node computes the histograms of all the requested features of a block, so
+// the gradients of a sample are gathered once per block instead of once per
+// feature.
+//
+// Features with more than 65536 integerized values are not bundled and have no
+// block.
+class BinMatrix {
+ public:
+  // block_bytes bounds the memory of the histograms of a block. The features are
+  // spread over at least min_num_blocks blocks when possible so that the blocks
+  // can be processed in parallel.
+  BinMatrix(const vector<const Column*>& features, size_t block_bytes, int min_num_blocks);
+
+  inline int num_blocks() const {
+    return blocks_.size();
+  }
+
+  // Returns the block of the feature, or -1 if the feature is not bundled.
+  inline int block_of(uint feature_index) const {
+    return feature_index < block_of_.size() ? block_of_[feature_index] : -1;
+  }
+
+  // Computes the dense histograms of the features on the samples in one pass.
+  // ordered_gradients holds the weighted gradients aligned with the samples. All
+  // the features must be in the block. histograms[i] is indexed by the integerized
+  // values of feature_indices[i].
+  void ComputeHistograms(int block,
+                         const vector<uint>& feature_indices,
+                         const VectorSlice<uint>& samples,
+                         const VectorSlice<GradientData>& ordered_gradients,
+                         vector<vector<GradientData>>* histograms) const;
+  void ComputeHistograms(int block,
+                         const vector<uint>& feature_indices,
+                         const VectorSlice<uint>& samples,
+                         const VectorSlice<CompactGradientData>& ordered_gradients,
+                         vector<vector<GradientData>>* histograms) const;
+  // Same as above but for gradients quantized in units of scale. INT is int8 or
+  // int16.
+  template <typename INT>
+  void ComputeHistograms(int block,
+                         const vector<uint>& feature_indices,
+                         const VectorSlice<uint>& samples,
+                         const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+                         const GradientData& scale,
+                         vector<vector<GradientData>>* histograms) const;
+
+  // Memory footprint of the bins in bytes.
+  size_t memory_size() const;
+
+ private:
+  struct Block {
+    // Indices of the features in the block. A row of the block stores the bins
+    // of the features in this order.
+    vector<uint> features;
+    vector<uint> max_ints;
+    // Row-major bins. Only one of them is used depending on the max_int of the
+    // features in the block.
+    vector<uint8> bins_8;
+    vector<uint16> bins_16;
+  };
+
+  void FillBlock(const vector<const Column*>& features, Block* block);
+  template <typename GRADIENT>
+  void ComputeBlockHistograms(int block,
+                              const vector<uint>& feature_indices,
+                              const VectorSlice<uint>& samples,
+                              const VectorSlice<GRADIENT>& ordered_gradients,
+                              vector<vector<GradientData>>* histograms) const;
+
+  uint num_rows_ = 0;
+  vector<Block> blocks_;
+  // Block and offset in the row of the block, indexed by feature index.
+  vector<int> block_of_;
+  vector<int> offset_of_;
+};
+
+}  // namespace gbdt
+
+#endif  // BIN_MATRIX_H_
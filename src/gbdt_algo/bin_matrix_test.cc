@@ -0,0 +1,112 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bin_matrix.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "split_algo.h"
+#include "src/data_store/column.h"
+
+namespace gbdt {
+
+class BinMatrixTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    const int n = 1000;
+    vector<float> floats(n);
+    vector<string> few_strings(n);
+    vector<string> many_strings(n);
+    for (int i = 0; i < n; ++i) {
+      floats[i] = i % 7 == 0 ? NAN : (i * 37) % 101;
+      few_strings[i] = std::to_string(i % 13);
+      many_strings[i] = std::to_string((i * 7) % 600);
+      gradient_data_vec_.push_back(GradientData(i % 5 - 2.0, 1.0 + i % 3));
+      weights_.push_back(0.5 + i % 4);
+      if (i % 3 != 0) samples_.push_back(i);
+    }
+    features_.push_back(Column::CreateBucketizedFloatColumn("float", floats));
+    features_.push_back(Column::CreateStringColumn("few_strings", few_strings));
+    features_.push_back(Column::CreateRawFloatColumn("raw", vector<float>(floats)));
+    features_.push_back(Column::CreateStringColumn("many_strings", many_strings));
+    features_.push_back(Column::CreateStringColumn("more_strings", many_strings));
+    for (const auto& feature : features_) {
+      feature_ptrs_.push_back(feature.get());
+    }
+  }
+
+  // Expects that the histograms computed from the bin matrix are exactly the same as
+  // those computed from the columns.
+  void ExpectSameHistograms(const BinMatrix& bin_matrix, FloatVector w) {
+    for (int block = 0; block < bin_matrix.num_blocks(); ++block) {
+      vector<uint> block_features;
+      for (uint i = 0; i < feature_ptrs_.size(); ++i) {
+        if (bin_matrix.block_of(i) == block) block_features.push_back(i);
+      }
+      vector<GradientData> ordered_gradients;
+      for (auto index : samples_) {
+        ordered_gradients.push_back(w(index) * gradient_data_vec_[index]);
+      }
+      vector<vector<GradientData>> histograms;
+      bin_matrix.ComputeHistograms(block, block_features, samples_, ordered_gradients,
+                                   &histograms);
+      ASSERT_EQ(block_features.size(), histograms.size());
+      for (uint j = 0; j < block_features.size(); ++j) {
+        const auto& feature = static_cast<const IntegerizedColumn&>(
+            *feature_ptrs_[block_features[j]]);
+        Histogram expected(feature, w, gradient_data_vec_, samples_);
+        Histogram actual(std::move(histograms[j]));
+        ASSERT_EQ(expected.size(), actual.size());
+        for (int k = 0; k < expected.size(); ++k) {
+          EXPECT_EQ(expected.value(k), actual.value(k));
+          EXPECT_EQ(expected.data(k).g, actual.data(k).g);
+          EXPECT_EQ(expected.data(k).h, actual.data(k).h);
+        }
+      }
+    }
+  }
+
+  vector<unique_ptr<Column>> features_;
+  vector<const Column*> feature_ptrs_;
+  vector<GradientData> gradient_data_vec_;
+  vector<float> weights_;
+  vector<uint> samples_;
+};
+
+TEST_F(BinMatrixTest, Blocks) {
+  BinMatrix bin_matrix(feature_ptrs_, 1 << 20, 1);
+  // 8 bit and 16 bit features are bundled into different blocks.
+  EXPECT_EQ(2, bin_matrix.num_blocks());
+  EXPECT_EQ(bin_matrix.block_of(0), bin_matrix.block_of(1));
+  EXPECT_EQ(-1, bin_matrix.block_of(2));
+  EXPECT_EQ(bin_matrix.block_of(3), bin_matrix.block_of(4));
+  EXPECT_NE(bin_matrix.block_of(0), bin_matrix.block_of(3));
+
+  // The histograms of a block are bounded by the budget.
+  BinMatrix small_blocks(feature_ptrs_, 1, 1);
+  EXPECT_EQ(4, small_blocks.num_blocks());
+}
+
+TEST_F(BinMatrixTest, ComputeHistograms) {
+  BinMatrix bin_matrix(feature_ptrs_, 1 << 20, 1);
+  ExpectSameHistograms(bin_matrix, FloatVector(weights_));
+  ExpectSameHistograms(bin_matrix, FloatVector());
+}
+
+}  // namespace gbdt
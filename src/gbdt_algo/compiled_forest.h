@@ -0,0 +1,149 @@
+/* Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPILED_FOREST_H_
+#define COMPILED_FOREST_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "src/base/base.h"
+
+namespace gbdt {
+
+class DataStore;
+class Forest;
+class IntegerizedColumn;
+class TreeNode;
+
+// CompiledForest is a forest compiled against the columns of a data store for
+// batch scoring. The nodes of all the trees are kept in flat arrays, with the
+// columns resolved, the float splits turned into bucket thresholds and the
+// categorical splits into bitsets, so that routing a row costs neither a lookup
+// of the feature by name nor a walk over the protos.
+class CompiledForest {
+ public:
+  // The features of the forest must be loaded in the data store.
+  CompiledForest(const Forest& forest, DataStore* data_store);
+
+  inline int num_trees() const {
+    return roots_.size();
+  }
+
+  // Adds the scores of the trees [begin, end) to the scores of the rows. The
+  // scores are added tree by tree, so they are the same as those of
+  // ComputeTreeScores.
+  void AddTreeScores(int begin, int end, vector<double>* scores) const;
+
+  // Scores the rows through the trees [0, checkpoints.back()) in one pass and
+  // sets (*scores)[k] to the scores of the trees [0, checkpoints[k]). The
+  // checkpoints must be increasing.
+  void ScoreCheckpoints(const vector<int>& checkpoints, vector<vector<double>>* scores) const;
+
+ private:
+  // Raw storage of a column as in IntegerizedColumn::VisitRawCol.
+  struct RawColumn {
+    const void* data;
+    int bytes;
+  };
+
+  // Node flags.
+  enum : uint8 {
+    kCategorical = 1,
+    kMissingToLeft = 2,
+  };
+  // Key of the rows that go to the right regardless of the threshold.
+  enum : uint { kRightKey = 0xffffffff };
+  // Rows taken through a tree at once by GetLeaves.
+  enum { kNumLanes = 8 };
+
+  // Returns the index of the node, or ~leaf for a leaf.
+  int CompileNode(const TreeNode& node, DataStore* data_store);
+  int CompileColumn(const IntegerizedColumn* column);
+
+  // Adds the scores of the trees [begin_tree, end_tree) to the rows
+  // [begin_row, end_row), where scores points to the score of begin_row. The
+  // rows are taken through one tree at a time while their values stay in cache.
+  void ScoreRowBlock(uint begin_row, uint end_row, int begin_tree, int end_tree,
+                     double* scores) const;
+
+  inline uint GetValue(int column, uint row) const {
+    const auto& raw_column = columns_[column];
+    switch (raw_column.bytes) {
+      case 1:
+        return static_cast<const uint8*>(raw_column.data)[row];
+      case 2:
+        return static_cast<const uint16*>(raw_column.data)[row];
+      default:
+        return static_cast<const uint32*>(raw_column.data)[row];
+    }
+  }
+
+  // Returns the key of the row at the node, which is below the threshold of the
+  // node iff the row goes to the left. The key of a float split is the bucket
+  // unless it is missing, while the missing values and the categorical splits
+  // are resolved to 0 for the left and kRightKey for the right.
+  inline uint GetKey(int node, uint row) const {
+    uint value = GetValue(columns_of_nodes_[node], row);
+    if (flags_[node] & kCategorical) {
+      return (category_bits_[category_offsets_[node] + (value >> 6)] >> (value & 63)) & 1 ?
+          0 : kRightKey;
+    }
+    // Bucket 0 represents missing.
+    if (value == 0) {
+      return flags_[node] & kMissingToLeft ? 0 : kRightKey;
+    }
+    return value;
+  }
+
+  // Returns the leaf of the tree that the row falls in.
+  inline int GetLeaf(int tree, uint row) const {
+    int node = roots_[tree];
+    while (node >= 0) {
+      node = GetKey(node, row) < thresholds_[node] ? left_children_[node] : right_children_[node];
+    }
+    return ~node;
+  }
+
+  // Same as GetLeaf but for kNumLanes consecutive rows from row at once, which
+  // are taken through the tree together with AVX2.
+  void GetLeaves(int tree, uint row, int* leaves) const;
+
+  uint num_rows_ = 0;
+  // Root of each tree, which is ~leaf if the tree is a single leaf.
+  vector<int> roots_;
+  // Whether the rows are taken through the tree kNumLanes at a time, which pays
+  // off unless the rows end at leaves of very different depths.
+  vector<bool> multi_row_trees_;
+  vector<RawColumn> columns_;
+  unordered_map<const IntegerizedColumn*, int> column_indices_;
+
+  // Internal nodes. thresholds_ holds the bucket thresholds of float splits and
+  // 1 for categorical splits, whose bitsets start at category_offsets_.
+  vector<int> columns_of_nodes_;
+  vector<uint> thresholds_;
+  vector<uint8> flags_;
+  vector<int> category_offsets_;
+  vector<int> left_children_;
+  vector<int> right_children_;
+  // Bitsets of the categorical splits, each covering the categories of its column.
+  vector<uint64> category_bits_;
+
+  vector<double> leaf_scores_;
+};
+
+}  // namespace gbdt
+
+#endif  // COMPILED_FOREST_H_
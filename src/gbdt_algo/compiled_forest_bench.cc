@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the scoring of a random forest by ComputeTreeScores, by the scalar
+// traversal of CompiledForest and by its multi-row traversal, for a range of
+// tree depths. Usage:
+//
+//   compiled_forest_bench --bench_rows=1000000 --bench_trees=100 --bench_depths=4,6,8,12,16
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <iostream>
+#include <random>
+
+#include "external/cppformat/format.h"
+
+#include "compiled_forest.h"
+#include "compute_tree_scores.h"
+#include "src/base/base.h"
+#include "src/data_store/column.h"
+#include "src/data_store/data_store.h"
+#include "src/proto/tree.pb.h"
+#include "src/utils/stopwatch.h"
+#include "src/utils/utils.h"
+
+DEFINE_int32(bench_rows, 1000000, "The number of rows.");
+DEFINE_int32(bench_features, 20, "The number of float features.");
+DEFINE_int32(bench_trees, 100, "The number of trees.");
+DEFINE_string(bench_depths, "4,6,8,10,12,14,16", "The comma separated depths of the trees.");
+DEFINE_int32(bench_repeats, 3, "The number of runs of each engine, of which the fastest counts.");
+DECLARE_bool(simd_scoring);
+
+namespace gbdt {
+
+namespace {
+
+// Grows a tree that stops at each node with a small probability, so that the
+// leaves are at various depths as in trained trees.
+void RandomTree(int depth, mt19937* rng, TreeNode* node) {
+  if (depth == 0 || (*rng)() % 16 == 0) {
+    node->set_score(((*rng)() % 1000) / 1000.0);
+    return;
+  }
+  auto* split = node->mutable_split();
+  split->set_feature(fmt::format("f{0}", (*rng)() % FLAGS_bench_features));
+  split->mutable_float_split()->set_threshold(((*rng)() % 1000) / 1000.0);
+  split->mutable_float_split()->set_missing_to_right_child((*rng)() % 2);
+  RandomTree(depth - 1, rng, node->mutable_left_child());
+  RandomTree(depth - 1, rng, node->mutable_right_child());
+}
+
+template <typename Func>
+double BestTimeInMSecs(Func&& f) {
+  double best = 0;
+  for (int i = 0; i < FLAGS_bench_repeats; ++i) {
+    StopWatch stopwatch;
+    stopwatch.Start();
+    f();
+    stopwatch.End();
+    if (i == 0 || stopwatch.ElapsedTimeInMSecs() < best) {
+      best = stopwatch.ElapsedTimeInMSecs();
+    }
+  }
+  return best;
+}
+
+void Run() {
+  mt19937 rng(1234567);
+  DataStore data_store;
+  for (int i = 0; i < FLAGS_bench_features; ++i) {
+    vector<float> values(FLAGS_bench_rows);
+    for (auto& value : values) {
+      value = rng() % 20 == 0 ? NAN : (rng() % 1000) / 1000.0;
+    }
+    data_store.Add(Column::CreateBucketizedFloatColumn(fmt::format("f{0}", i), values));
+  }
+
+  cout << fmt::format("{0:>6}{1:>24}{2:>18}{3:>18}\n", "depth", "ComputeTreeScores ms",
+                      "scalar ms", "multi-row ms");
+  for (const auto& depth : strings::split(FLAGS_bench_depths, ",")) {
+    Forest forest;
+    for (int i = 0; i < FLAGS_bench_trees; ++i) {
+      RandomTree(stoi(depth), &rng, forest.add_tree());
+    }
+
+    vector<double> expected_scores(FLAGS_bench_rows, 0.0);
+    ComputeTreeScores compute_tree_scores(&data_store);
+    double tree_time = BestTimeInMSecs([&]() {
+        expected_scores.assign(FLAGS_bench_rows, 0.0);
+        for (const auto& tree : forest.tree()) {
+          compute_tree_scores.AddTreeScores(tree, &expected_scores);
+        }
+      });
+
+    double times[2];
+    for (int simd = 0; simd < 2; ++simd) {
+      FLAGS_simd_scoring = simd;
+      CompiledForest compiled_forest(forest, &data_store);
+      vector<double> scores;
+      times[simd] = BestTimeInMSecs([&]() {
+          scores.assign(FLAGS_bench_rows, 0.0);
+          compiled_forest.AddTreeScores(0, compiled_forest.num_trees(), &scores);
+        });
+      CHECK(scores == expected_scores) << "The scores differ at depth " << depth;
+    }
+    cout << fmt::format("{0:>6}{1:>24.1f}{2:>18.1f}{3:>18.1f}\n", depth, tree_time, times[0],
+                        times[1]);
+  }
+}
+
+}  // namespace
+
+}  // namespace gbdt
+
+int main(int argc, char* argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  gbdt::Run();
+  return 0;
+}
@@ -0,0 +1,202 @@
+/* Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compiled_forest.h"
+
+#include <gflags/gflags.h>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <google/protobuf/text_format.h>
+
+#include "compute_tree_scores.h"
+#include "gtest/gtest.h"
+#include "src/base/base.h"
+#include "src/data_store/column.h"
+#include "src/data_store/data_store.h"
+#include "src/proto/tree.pb.h"
+
+DECLARE_bool(simd_scoring);
+
+namespace gbdt {
+
+class CompiledForestTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    auto color = Column::CreateStringColumn(
+        "color",
+        {"red", "blue", "green", "blue", "red", "red", "blue", "green", "red", "blue"});
+    auto length = Column::CreateBucketizedFloatColumn(
+        "length", vector<float>({2, 1, 1, 3, 2, 4, 10, 2, 7, 5}));
+    auto width = Column::CreateBucketizedFloatColumn(
+        "width", vector<float>({2, 3, 7, 3, NAN, 4, 6, 2, NAN, 5}));
+
+    data_store_.Add(std::move(color));
+    data_store_.Add(std::move(length));
+    data_store_.Add(std::move(width));
+
+    string text = "tree { score: 0.5 }"
+                  "tree {"
+                  "  split { feature: 'color' cat_split { category: ['red', 'green'] } }"
+                  "  left_child {"
+                  "    split { feature: 'length' float_split { threshold: 3.0 } }"
+                  "    left_child { "
+                  "      split { feature: 'width' float_split { threshold: 5.0 } } "
+                  "      left_child { score: 0.0 }"
+                  "      right_child { score: 1.0 }"
+                  "    }"
+                  "    right_child { score: 2.0 }"
+                  "  }"
+                  "  right_child { score: 3.0 }"
+                  "}"
+                  "tree {"
+                  "  split { feature: 'width' float_split { threshold: 4.5 "
+                  "                                         missing_to_right_child: true } }"
+                  "  left_child { score: 0.25 }"
+                  "  right_child {"
+                  "    split { feature: 'color' cat_split { category: ['blue'] } }"
+                  "    left_child { score: 0.125 }"
+                  "    right_child { score: 4.0 }"
+                  "  }"
+                  "}";
+    CHECK(google::protobuf::TextFormat::ParseFromString(text, &forest_));
+  }
+
+  DataStore data_store_;
+  Forest forest_;
+};
+
+TEST_F(CompiledForestTest, SameScoresAsComputeTreeScores) {
+  ComputeTreeScores compute_tree_scores(&data_store_);
+  vector<double> expected_scores(data_store_.num_rows(), 1.0);
+  for (const auto& tree : forest_.tree()) {
+    compute_tree_scores.AddTreeScores(tree, &expected_scores);
+  }
+
+  CompiledForest compiled_forest(forest_, &data_store_);
+  EXPECT_EQ(3, compiled_forest.num_trees());
+  vector<double> scores(data_store_.num_rows(), 1.0);
+  compiled_forest.AddTreeScores(0, compiled_forest.num_trees(), &scores);
+  EXPECT_EQ(expected_scores, scores);
+
+  // Scoring the trees in ranges gives the same scores.
+  scores = vector<double>(data_store_.num_rows(), 1.0);
+  compiled_forest.AddTreeScores(0, 2, &scores);
+  compiled_forest.AddTreeScores(2, 3, &scores);
+  EXPECT_EQ(expected_scores, scores);
+}
+
+TEST_F(CompiledForestTest, ScoreCheckpoints) {
+  CompiledForest compiled_forest(forest_, &data_store_);
+  vector<vector<double>> scores;
+  compiled_forest.ScoreCheckpoints({1, 3}, &scores);
+  ASSERT_EQ(2, scores.size());
+
+  vector<double> expected_scores(data_store_.num_rows(), 0.0);
+  compiled_forest.AddTreeScores(0, 1, &expected_scores);
+  EXPECT_EQ(expected_scores, scores[0]);
+  compiled_forest.AddTreeScores(1, 3, &expected_scores);
+  EXPECT_EQ(expected_scores, scores[1]);
+}
+
+TEST(CompiledForestBlockTest, ScoreManyRowBlocks) {
+  // Enough rows for several row blocks, with the last one partial.
+  const int kNumRows = 5000;
+  vector<float> length(kNumRows);
+  for (int i = 0; i < kNumRows; ++i) {
+    length[i] = i % 97;
+  }
+  DataStore data_store;
+  data_store.Add(Column::CreateBucketizedFloatColumn("length", length));
+
+  Forest forest;
+  string text = "tree {"
+                "  split { feature: 'length' float_split { threshold: 40.0 } }"
+                "  left_child { score: 1.0 }"
+                "  right_child { score: 2.0 }"
+                "}"
+                "tree {"
+                "  split { feature: 'length' float_split { threshold: 80.0 } }"
+                "  left_child { score: 0.5 }"
+                "  right_child { score: 4.0 }"
+                "}";
+  CHECK(google::protobuf::TextFormat::ParseFromString(text, &forest));
+
+  ComputeTreeScores compute_tree_scores(&data_store);
+  vector<double> expected_scores(kNumRows, 0.0);
+  compute_tree_scores.AddTreeScores(forest.tree(0), &expected_scores);
+  CompiledForest compiled_forest(forest, &data_store);
+  vector<vector<double>> scores;
+  compiled_forest.ScoreCheckpoints({1, 2}, &scores);
+  EXPECT_EQ(expected_scores, scores[0]);
+  compute_tree_scores.AddTreeScores(forest.tree(1), &expected_scores);
+  EXPECT_EQ(expected_scores, scores[1]);
+}
+
+TEST(CompiledForestSimdTest, SameScoresWithAndWithoutSimd) {
+  const vector<string> kColors = {"red", "blue", "green", "yellow"};
+  mt19937 rng(1);
+  const int kNumRows = 3001;
+  vector<string> colors;
+  vector<float> lengths;
+  for (int i = 0; i < kNumRows; ++i) {
+    colors.push_back(kColors[rng() % kColors.size()]);
+    lengths.push_back(rng() % 5 == 0 ? NAN : rng() % 100);
+  }
+  DataStore data_store;
+  data_store.Add(Column::CreateStringColumn("color", colors));
+  data_store.Add(Column::CreateBucketizedFloatColumn("length", lengths));
+
+  // Random trees of various depths, some too deep for the multi-row traversal.
+  function<void(int, TreeNode*)> random_tree = [&](int depth, TreeNode* node) {
+    if (depth == 0 || rng() % 8 == 0) {
+      node->set_score((rng() % 1000) / 100.0);
+      return;
+    }
+    auto* split = node->mutable_split();
+    if (rng() % 3 == 0) {
+      split->set_feature("color");
+      split->mutable_cat_split()->add_category(kColors[rng() % kColors.size()]);
+    } else {
+      split->set_feature("length");
+      split->mutable_float_split()->set_threshold(rng() % 100 + 0.5);
+      split->mutable_float_split()->set_missing_to_right_child(rng() % 2);
+    }
+    random_tree(depth - 1, node->mutable_left_child());
+    random_tree(depth - 1, node->mutable_right_child());
+  };
+  Forest forest;
+  for (int depth : {0, 1, 3, 6, 10, 14, 16}) {
+    random_tree(depth, forest.add_tree());
+  }
+
+  ComputeTreeScores compute_tree_scores(&data_store);
+  vector<double> expected_scores(kNumRows, 0.0);
+  for (const auto& tree : forest.tree()) {
+    compute_tree_scores.AddTreeScores(tree, &expected_scores);
+  }
+
+  bool old_simd = FLAGS_simd_scoring;
+  for (int simd = 0; simd < 2; ++simd) {
+    FLAGS_simd_scoring = simd;
+    CompiledForest compiled_forest(forest, &data_store);
+    vector<double> scores(kNumRows, 0.0);
+    compiled_forest.AddTreeScores(0, compiled_forest.num_trees(), &scores);
+    EXPECT_EQ(expected_scores, scores) << "simd: " << simd;
+  }
+  FLAGS_simd_scoring = old_simd;
+}
+
+}  // namespace gbdt
@@ -16,9 +16,11 @@
 #include "compute_tree_scores.h"
 
 #include <gflags/gflags.h>
+#include <unordered_map>
 
 #include "split_algo.h"
 #include "src/base/base.h"
+#include "src/data_store/column.h"
 #include "src/data_store/data_store.h"
 #include "src/proto/tree.pb.h"
 #include "src/utils/subsampling.h"
@@ -29,8 +31,28 @@ DECLARE_int32(num_threads);
 
 namespace gbdt {
 
+namespace {
+
+// Categorical splits of a tree compiled into bitsets, indexed by node.
+typedef unordered_map<const TreeNode*, CategoryBitset> CompiledCategories;
+
+void CompileCategories(DataStore* data_store, const TreeNode* tree,
+                       CompiledCategories* compiled_categories) {
+  if (!tree->has_left_child()) return;
+  if (tree->split().has_cat_split()) {
+    const auto* column = data_store->GetStringColumn(tree->split().feature());
+    CHECK(column) << "Failed to load feature " << tree->split().feature();
+    compiled_categories->emplace(tree, CategoryBitset(*column, tree->split()));
+  }
+  CompileCategories(data_store, &tree->left_child(), compiled_categories);
+  CompileCategories(data_store, &tree->right_child(), compiled_categories);
+}
+
+}  // namespace
+
 void AddSampleTreeScores(DataStore* data_store,
                          const TreeNode* tree,
+                         const CompiledCategories& compiled_categories,
                          double constant,
                          VectorSlice<uint> samples,
                          vector<double>* scores) {
@@ -38,9 +60,14 @@ void AddSampleTreeScores(DataStore* data_store,
     auto* column = data_store->GetColumn(tree->split().feature());
 
     CHECK(column) << "Failed to load feature " << tree->split().feature();
-    auto slices = Partition(column, tree->split(), samples);
-    AddSampleTreeScores(data_store, &tree->left_child(), constant, slices.first, scores);
-    AddSampleTreeScores(data_store, &tree->right_child(), constant, slices.second, scores);
+    auto it = compiled_categories.find(tree);
+    auto slices = it != compiled_categories.end() ?
+        Partition(static_cast<const StringColumn*>(column), it->second, samples) :
+        Partition(column, tree->split(), samples);
+    AddSampleTreeScores(data_store, &tree->left_child(), compiled_categories, constant,
+                        slices.first, scores);
+    AddSampleTreeScores(data_store, &tree->right_child(), compiled_categories, constant,
+                        slices.second, scores);
   } else {
     for (auto index : samples) {
       (*scores)[index] += tree->score() + constant;
@@ -56,11 +83,15 @@ ComputeTreeScores::ComputeTreeScores(DataStore* data_store)
 
 void ComputeTreeScores::AddTreeScores(const TreeNode& tree, double constant,
                                       vector<double>* scores) const {
+  // Compile the categorical splits once for all the slices.
+  CompiledCategories compiled_categories;
+  CompileCategories(data_store_, &tree, &compiled_categories);
+
   // Compute tree scores
-  ThreadPool pool(FLAGS_num_threads);
-  for (auto slice : slices_) {
-    pool.Enqueue(std::bind(AddSampleTreeScores, data_store_, &tree, constant, slice, scores));
-  }
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices_.size(), [&](int i) {
+      AddSampleTreeScores(data_store_, &tree, compiled_categories, constant, slices_[i],
+                          scores);
+    });
 }
 
 void ComputeTreeScores::AddTreeScores(const TreeNode& tree, vector<double>* scores) const {
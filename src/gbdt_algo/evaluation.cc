@@ -16,6 +16,7 @@
 
 #include "evaluation.h"
 
+#include <gflags/gflags.h>
 #include <algorithm>
 #include <fstream>
 #include <functional>
@@ -26,7 +27,8 @@
 
 #include "external/cppformat/format.h"
 
-#include "compute_tree_scores.h"
+#include "compiled_forest.h"
+#include "quick_scorer.h"
 #include "split_algo.h"
 #include "src/base/base.h"
 #include "src/data_store/data_store.h"
@@ -35,8 +37,30 @@
 #include "src/utils/utils.h"
 #include "utils.h"
 
+DECLARE_bool(quick_scorer);
+
 namespace gbdt {
 
+namespace {
+
+// Scores the rows at the checkpoints with QuickScorer when asked for and the
+// trees are small enough, and with CompiledForest otherwise.
+void ScoreCheckpoints(DataStore* data_store,
+                      const Forest& forest,
+                      const vector<int>& checkpoints,
+                      vector<vector<double>>* scores) {
+  if (FLAGS_quick_scorer) {
+    if (QuickScorer::CanScore(forest)) {
+      QuickScorer(forest, data_store).ScoreCheckpoints(checkpoints, scores);
+      return;
+    }
+    LOG(WARNING) << "The forest has trees too large for QuickScorer. Scoring it by the trees.";
+  }
+  CompiledForest(forest, data_store).ScoreCheckpoints(checkpoints, scores);
+}
+
+}  // namespace
+
 bool WriteScoreFile(const string& filename,
                     const vector<double>& scores) {
   ofstream out_file;
@@ -64,18 +88,11 @@ Status EvaluateForest(DataStore* data_store,
   if (!status.ok()) return status;
   mkdir(output_dir.c_str(), 0744);
 
-  ComputeTreeScores compute_tree_scores(data_store);
-
-  vector<double> scores(data_store->num_rows(), 0.0);
+  // The trees after which the scores are written.
+  vector<int> checkpoints;
   for (int i = 0; i < forest.tree_size() && !test_points.empty(); ++i) {
-    compute_tree_scores.AddTreeScores(forest.tree(i), &scores);
-
     if (i+1 == test_points.front()) {
-      string score_file =fmt::format("{0}/forest.{1}.score", output_dir, test_points.front());
-      if (!WriteScoreFile(score_file, scores)) {
-        return Status(error::ABORTED, "Failed to write into the score files.");
-      }
-      LOG(INFO) << fmt::format("Wrote {0}.", score_file);
+      checkpoints.push_back(i+1);
     }
 
     while (!test_points.empty() && i+1 >= test_points.front()) {
@@ -83,6 +100,17 @@ Status EvaluateForest(DataStore* data_store,
     }
   }
 
+  // The scores at all the checkpoints are computed in one pass over the rows.
+  vector<vector<double>> scores;
+  ScoreCheckpoints(data_store, forest, checkpoints, &scores);
+  for (int k = 0; k < checkpoints.size(); ++k) {
+    string score_file = fmt::format("{0}/forest.{1}.score", output_dir, checkpoints[k]);
+    if (!WriteScoreFile(score_file, scores[k])) {
+      return Status(error::ABORTED, "Failed to write into the score files.");
+    }
+    LOG(INFO) << fmt::format("Wrote {0}.", score_file);
+  }
+
   return Status::OK;
 }
 
@@ -93,12 +121,9 @@ Status EvaluateForest(DataStore* data_store,
   auto status = LoadFeatures(feature_names, data_store, nullptr);
   if (!status.ok()) return status;
 
-  ComputeTreeScores compute_tree_scores(data_store);
-  scores->clear();
-  scores->resize(data_store->num_rows(), 0.0);
-  for (const auto& tree : forest.tree()) {
-    compute_tree_scores.AddTreeScores(tree, scores);
-  }
+  vector<vector<double>> checkpoint_scores;
+  ScoreCheckpoints(data_store, forest, {forest.tree_size()}, &checkpoint_scores);
+  *scores = std::move(checkpoint_scores[0]);
   return Status::OK;
 }
 
@@ -18,6 +18,7 @@
 #include <algorithm>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <memory>
 #include <queue>
 #include <string>
 #include <utility>
@@ -25,6 +26,7 @@
 
 #include "external/cppformat/format.h"
 
+#include "bin_matrix.h"
 #include "compute_tree_scores.h"
 #include "split_algo.h"
 #include "src/base/base.h"
@@ -41,6 +43,8 @@
 #include "tree_algo.h"
 #include "utils.h"
 
+DECLARE_bool(bin_matrix);
+DECLARE_int32(bin_matrix_block_kb);
 DECLARE_int32(num_threads);
 
 namespace gbdt {
@@ -66,6 +70,9 @@ void ClearInternalFields(TreeNode* tree) {
     if (tree->split().has_cat_split()) {
       tree->mutable_split()->mutable_cat_split()->clear_internal_categorical_index();
     }
+    if (tree->split().has_float_split()) {
+      tree->mutable_split()->mutable_float_split()->clear_internal_bucket_threshold();
+    }
   }
   if (tree->has_left_child()) {
     ClearInternalFields(tree->mutable_left_child());
@@ -146,6 +153,11 @@ Status TrainGBDT(DataStore* data_store,
   vector<double> f(num_rows, 0);  // current function values
   vector<GradientData> gradient_data(num_rows);
   ComputeTreeScores compute_tree_scores(data_store);
+  unique_ptr<BinMatrix> bin_matrix;
+  if (FLAGS_bin_matrix) {
+    bin_matrix.reset(new BinMatrix(features, static_cast<size_t>(FLAGS_bin_matrix_block_kb) << 10,
+                                   FLAGS_num_threads));
+  }
 
   // The first tree is constant tree. Throughout the learning process, we will keep
   // updating the constant. The main reason for doing that is to exclude constant
@@ -185,7 +197,7 @@ Status TrainGBDT(DataStore* data_store,
     // Add a tree to forest
     auto* tree = forest->add_tree();
     // Fit a tree to gradients and apply the shrinkage
-    *tree = FitTreeToGradients(w, gradient_data, features, config);
+    *tree = FitTreeToGradients(w, gradient_data, features, config, bin_matrix.get());
 
     // Apply Shrinkage to the tree
     ApplyShrinkage(tree, config.shrinkage());
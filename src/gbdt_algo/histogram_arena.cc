@@ -0,0 +1,93 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "histogram_arena.h"
+
+#include <gflags/gflags.h>
+
+DECLARE_int32(histogram_arena_mb);
+
+namespace gbdt {
+
+namespace {
+
+// The smallest k such that 2^k >= size.
+inline int CeilLog2(uint size) {
+  return size <= 1 ? 0 : 32 - __builtin_clz(size - 1);
+}
+
+// The largest k such that 2^k <= size.
+inline int FloorLog2(uint size) {
+  return size <= 1 ? 0 : 31 - __builtin_clz(size);
+}
+
+}  // namespace
+
+HistogramArena* HistogramArena::Get() {
+  thread_local HistogramArena arena;
+  return &arena;
+}
+
+template <typename T>
+vector<T> HistogramArena::FreeLists<T>::Allocate(uint size, size_t* free_bytes) {
+  int size_class = CeilLog2(size);
+  auto& free_list = lists_[size_class];
+  vector<T> buffer;
+  if (!free_list.empty()) {
+    buffer = std::move(free_list.back());
+    free_list.pop_back();
+    *free_bytes -= buffer.capacity() * sizeof(T);
+  } else {
+    buffer.reserve(static_cast<size_t>(1) << size_class);
+  }
+  return buffer;
+}
+
+template <typename T>
+void HistogramArena::FreeLists<T>::Release(vector<T>* buffer, size_t budget,
+                                           size_t* free_bytes) {
+  size_t bytes = buffer->capacity() * sizeof(T);
+  if (bytes == 0) return;
+  if (*free_bytes + bytes > budget) {
+    vector<T>().swap(*buffer);
+    return;
+  }
+  buffer->clear();
+  lists_[FloorLog2(buffer->capacity())].push_back(std::move(*buffer));
+  buffer->clear();
+  *free_bytes += bytes;
+}
+
+vector<GradientData> HistogramArena::AllocateHistogram(uint size) {
+  auto histogram = histograms_.Allocate(size, &free_bytes_);
+  histogram.assign(size, GradientData());
+  return histogram;
+}
+
+vector<uint> HistogramArena::AllocateValues(uint size) {
+  return values_.Allocate(size, &free_bytes_);
+}
+
+void HistogramArena::Release(vector<GradientData>* histogram) {
+  histograms_.Release(histogram, static_cast<size_t>(FLAGS_histogram_arena_mb) << 20,
+                      &free_bytes_);
+}
+
+void HistogramArena::Release(vector<uint>* values) {
+  values_.Release(values, static_cast<size_t>(FLAGS_histogram_arena_mb) << 20, &free_bytes_);
+}
+
+}  // namespace gbdt
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HISTOGRAM_ARENA_H_
+#define HISTOGRAM_ARENA_H_
+
+#include <vector>
+
+#include "src/base/base.h"
+#include "src/loss_func/gradient_data.h"
+
+namespace gbdt {
+
+// HistogramArena keeps the buffers of released histograms and hands them out
+// again, so that the buffers are reused across nodes and trees instead of being
+// allocated and freed for every histogram. Buffers are kept in power-of-two size
+// classes, and the free buffers of a thread are bounded by
+// FLAGS_histogram_arena_mb.
+//
+// Each thread has its own arena, so no locking is needed. A buffer released on a
+// different thread than it was allocated on simply moves to that thread's arena.
+class HistogramArena {
+ public:
+  // Returns the arena of the calling thread.
+  static HistogramArena* Get();
+
+  // Returns a zeroed histogram of the size.
+  vector<GradientData> AllocateHistogram(uint size);
+  // Returns an empty vector with a capacity of at least size.
+  vector<uint> AllocateValues(uint size);
+
+  // Takes the buffers back. The vectors are left empty.
+  void Release(vector<GradientData>* histogram);
+  void Release(vector<uint>* values);
+
+  // Memory of the free buffers in bytes.
+  size_t free_bytes() const {
+    return free_bytes_;
+  }
+
+ private:
+  template <typename T>
+  class FreeLists {
+   public:
+    vector<T> Allocate(uint size, size_t* free_bytes);
+    void Release(vector<T>* buffer, size_t budget, size_t* free_bytes);
+
+   private:
+    // Free buffers by size class. Buffers in class k have a capacity of at least 2^k.
+    vector<vector<T>> lists_[33];
+  };
+
+  FreeLists<GradientData> histograms_;
+  FreeLists<uint> values_;
+  size_t free_bytes_ = 0;
+};
+
+}  // namespace gbdt
+
+#endif  // HISTOGRAM_ARENA_H_
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "histogram_arena.h"
+
+#include <gflags/gflags.h>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+DECLARE_int32(histogram_arena_mb);
+
+namespace gbdt {
+
+TEST(HistogramArenaTest, ReusesReleasedBuffers) {
+  auto* arena = HistogramArena::Get();
+  auto histogram = arena->AllocateHistogram(1000);
+  ASSERT_EQ(1000, histogram.size());
+  histogram[10] = GradientData(1.0, 2.0);
+  const auto* data = histogram.data();
+  arena->Release(&histogram);
+  EXPECT_TRUE(histogram.empty());
+  EXPECT_EQ(1024 * sizeof(GradientData), arena->free_bytes());
+
+  // A histogram of the same size class gets the buffer back, zeroed.
+  histogram = arena->AllocateHistogram(600);
+  EXPECT_EQ(data, histogram.data());
+  ASSERT_EQ(600, histogram.size());
+  for (const auto& gradient_data : histogram) {
+    EXPECT_EQ(0, gradient_data.g);
+    EXPECT_EQ(0, gradient_data.h);
+  }
+  EXPECT_EQ(0, arena->free_bytes());
+  arena->Release(&histogram);
+
+  auto values = arena->AllocateValues(100);
+  EXPECT_TRUE(values.empty());
+  EXPECT_LE(100, values.capacity());
+  arena->Release(&values);
+}
+
+TEST(HistogramArenaTest, ArenasArePerThread) {
+  const HistogramArena* other_arena = nullptr;
+  std::thread thread([&] { other_arena = HistogramArena::Get(); });
+  thread.join();
+  EXPECT_NE(HistogramArena::Get(), other_arena);
+}
+
+TEST(HistogramArenaTest, RespectsBudget) {
+  int old_budget = FLAGS_histogram_arena_mb;
+  FLAGS_histogram_arena_mb = 1;
+  std::thread thread([] {
+      auto* arena = HistogramArena::Get();
+      // 64K buckets take 1MB.
+      auto first = arena->AllocateHistogram(1 << 16);
+      auto second = arena->AllocateHistogram(1 << 16);
+      arena->Release(&first);
+      arena->Release(&second);
+      EXPECT_EQ(1 << 20, arena->free_bytes());
+    });
+  thread.join();
+  FLAGS_histogram_arena_mb = old_budget;
+}
+
+}  // namespace gbdt
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "quick_scorer.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+
+#include "split_algo.h"
+#include "src/data_store/column.h"
+#include "src/data_store/data_store.h"
+#include "src/proto/tree.pb.h"
+#include "src/utils/threadpool.h"
+
+DECLARE_int32(num_threads);
+
+namespace gbdt {
+
+namespace {
+
+const int kMaxNumLeaves = 64;
+// Rows scored by a task.
+const uint kRowBlockSize = 1024;
+
+int CountLeaves(const TreeNode& node) {
+  if (!node.has_left_child()) return 1;
+  return CountLeaves(node.left_child()) + CountLeaves(node.right_child());
+}
+
+}  // namespace
+
+bool QuickScorer::CanScore(const Forest& forest) {
+  for (const auto& tree : forest.tree()) {
+    if (CountLeaves(tree) > kMaxNumLeaves) return false;
+  }
+  return true;
+}
+
+QuickScorer::QuickScorer(const Forest& forest, DataStore* data_store)
+    : num_rows_(data_store->num_rows()) {
+  CHECK(CanScore(forest)) << "The forest has trees of more than " << kMaxNumLeaves << " leaves.";
+  for (int i = 0; i < forest.tree_size(); ++i) {
+    leaf_offsets_.push_back(leaf_scores_.size());
+    int num_leaves = 0;
+    CompileNode(forest.tree(i), i, data_store, &num_leaves);
+  }
+  for (auto& feature : features_) {
+    sort(feature.float_conditions.begin(), feature.float_conditions.end(),
+         [](const Condition& a, const Condition& b) { return a.threshold < b.threshold; });
+  }
+}
+
+int QuickScorer::CompileNode(const TreeNode& node, int tree, DataStore* data_store,
+                             int* num_leaves) {
+  if (!node.has_left_child()) {
+    leaf_scores_.push_back(node.score());
+    ++*num_leaves;
+    return 1;
+  }
+
+  const auto& split = node.split();
+  const auto* column = data_store->GetColumn(split.feature());
+  CHECK(column) << "Failed to load feature " << split.feature();
+  CHECK(column->type() == Column::kStringColumn ||
+        column->type() == Column::kBucketizedFloatColumn)
+      << "Feature " << split.feature() << " is neither categorical nor bucketized.";
+
+  // The right turn at the node rules out the leaves of the left subtree.
+  int first_leaf = *num_leaves;
+  int num_left_leaves = CompileNode(node.left_child(), tree, data_store, num_leaves);
+  int num_right_leaves = CompileNode(node.right_child(), tree, data_store, num_leaves);
+  uint64 left_leaves = ((uint64(1) << num_left_leaves) - 1) << first_leaf;
+  Condition condition{0, tree, ~left_leaves};
+
+  auto& feature = features_[GetFeature(static_cast<const IntegerizedColumn*>(column))];
+  if (split.has_cat_split()) {
+    CategoryBitset categories(*static_cast<const StringColumn*>(column), split);
+    condition.threshold = category_bits_.size();
+    category_bits_.insert(category_bits_.end(), categories.bits().begin(),
+                          categories.bits().end());
+    feature.categorical_conditions.push_back(condition);
+  } else {
+    CHECK(split.has_float_split()) << "Split and feature type mismatch for " << split.feature();
+    const auto& float_split = split.float_split();
+    condition.threshold = float_split.internal_bucket_threshold();
+    if (condition.threshold == 0) {
+      condition.threshold = static_cast<const BucketizedFloatColumn*>(column)->
+          get_bucket_threshold(float_split.threshold());
+    }
+    feature.float_conditions.push_back(condition);
+    if (float_split.missing_to_right_child()) {
+      feature.missing_conditions.push_back(condition);
+    }
+  }
+  return num_left_leaves + num_right_leaves;
+}
+
+int QuickScorer::GetFeature(const IntegerizedColumn* column) {
+  auto it = feature_indices_.find(column);
+  if (it != feature_indices_.end()) {
+    return it->second;
+  }
+  feature_indices_[column] = features_.size();
+  features_.emplace_back();
+  column->VisitRawCol([this](const auto& col) {
+      features_.back().column = RawColumn{col.data(), static_cast<int>(sizeof(col[0]))};
+    });
+  return features_.size() - 1;
+}
+
+void QuickScorer::ComputeLeaves(uint row, uint64* leaves) const {
+  fill(leaves, leaves + num_trees(), ~uint64(0));
+  for (const auto& feature : features_) {
+    uint value = GetValue(feature.column, row);
+    if (value == 0) {
+      // Bucket 0 represents missing.
+      for (const auto& condition : feature.missing_conditions) {
+        leaves[condition.tree] &= condition.mask;
+      }
+    } else {
+      // A non-missing value goes to the right iff it is not below the threshold.
+      for (const auto& condition : feature.float_conditions) {
+        if (condition.threshold > value) break;
+        leaves[condition.tree] &= condition.mask;
+      }
+    }
+    for (const auto& condition : feature.categorical_conditions) {
+      if (!((category_bits_[condition.threshold + (value >> 6)] >> (value & 63)) & 1)) {
+        leaves[condition.tree] &= condition.mask;
+      }
+    }
+  }
+}
+
+void QuickScorer::AddTreeScores(int begin, int end, vector<double>* scores) const {
+  CHECK_EQ(num_rows_, scores->size()) << "The scores don't match the rows of the data store.";
+  int num_blocks = (num_rows_ + kRowBlockSize - 1) / kRowBlockSize;
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(num_blocks, [&](int i) {
+      uint begin_row = i * kRowBlockSize;
+      uint end_row = min(begin_row + kRowBlockSize, num_rows_);
+      // The leaves of all the trees are computed, as the conditions of the
+      // trees of a feature are interleaved.
+      vector<uint64> leaves(num_trees());
+      for (uint row = begin_row; row < end_row; ++row) {
+        ComputeLeaves(row, leaves.data());
+        double score = (*scores)[row];
+        for (int tree = begin; tree < end; ++tree) {
+          score += GetLeafScore(tree, leaves.data());
+        }
+        (*scores)[row] = score;
+      }
+    });
+}
+
+void QuickScorer::ScoreCheckpoints(const vector<int>& checkpoints,
+                                   vector<vector<double>>* scores) const {
+  scores->clear();
+  scores->resize(checkpoints.size(), vector<double>(num_rows_, 0.0));
+  int num_blocks = (num_rows_ + kRowBlockSize - 1) / kRowBlockSize;
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(num_blocks, [&](int i) {
+      uint begin_row = i * kRowBlockSize;
+      uint end_row = min(begin_row + kRowBlockSize, num_rows_);
+      vector<uint64> leaves(num_trees());
+      for (uint row = begin_row; row < end_row; ++row) {
+        ComputeLeaves(row, leaves.data());
+        double score = 0.0;
+        int tree = 0;
+        for (int k = 0; k < checkpoints.size(); ++k) {
+          CHECK_GE(checkpoints[k], tree) << "The checkpoints are not increasing.";
+          for (; tree < checkpoints[k]; ++tree) {
+            score += GetLeafScore(tree, leaves.data());
+          }
+          (*scores)[k][row] = score;
+        }
+      }
+    });
+}
+
+}  // namespace gbdt
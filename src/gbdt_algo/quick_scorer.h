@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef QUICK_SCORER_H_
+#define QUICK_SCORER_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "src/base/base.h"
+
+namespace gbdt {
+
+class DataStore;
+class Forest;
+class IntegerizedColumn;
+class TreeNode;
+
+// QuickScorer scores a forest of trees with at most 64 leaves without walking
+// the trees. The leaves of a tree are numbered from left to right and a row
+// keeps a bitvector per tree of the leaves it may still reach. The splits are
+// grouped by feature and the float splits sorted by threshold, so for each
+// feature the splits that send the row to the right are found by a scan that
+// stops at the first threshold above its value. Each of them clears the leaves
+// of its left subtree from the bitvector of its tree, and the row exits at the
+// leftmost leaf left, which is found with a count of trailing zeros.
+//
+// See Lucchese et al., QuickScorer: a Fast Algorithm to Rank Documents with
+// Additive Ensembles of Regression Trees, SIGIR 2015.
+class QuickScorer {
+ public:
+  // Whether all the trees of the forest have at most 64 leaves.
+  static bool CanScore(const Forest& forest);
+
+  // The features of the forest must be loaded in the data store.
+  QuickScorer(const Forest& forest, DataStore* data_store);
+
+  inline int num_trees() const {
+    return leaf_offsets_.size();
+  }
+
+  // Same as CompiledForest::AddTreeScores. The scores are the same too.
+  void AddTreeScores(int begin, int end, vector<double>* scores) const;
+
+  // Same as CompiledForest::ScoreCheckpoints.
+  void ScoreCheckpoints(const vector<int>& checkpoints, vector<vector<double>>* scores) const;
+
+ private:
+  // Raw storage of a column as in IntegerizedColumn::VisitRawCol.
+  struct RawColumn {
+    const void* data;
+    int bytes;
+  };
+
+  // A split that clears mask from the bitvector of its tree when the row goes
+  // to the right. threshold is the bucket threshold of a float split, or the
+  // offset of the bitset of a categorical split in category_bits_.
+  struct Condition {
+    uint threshold;
+    int tree;
+    uint64 mask;
+  };
+
+  struct Feature {
+    RawColumn column;
+    // Float splits in ascending order of threshold.
+    vector<Condition> float_conditions;
+    // Float splits that send the missing values to the right.
+    vector<Condition> missing_conditions;
+    vector<Condition> categorical_conditions;
+  };
+
+  // Adds the conditions of the subtree, whose leaves are numbered from
+  // *num_leaves on. Returns the number of leaves of the subtree.
+  int CompileNode(const TreeNode& node, int tree, DataStore* data_store, int* num_leaves);
+  int GetFeature(const IntegerizedColumn* column);
+
+  inline uint GetValue(const RawColumn& column, uint row) const {
+    switch (column.bytes) {
+      case 1:
+        return static_cast<const uint8*>(column.data)[row];
+      case 2:
+        return static_cast<const uint16*>(column.data)[row];
+      default:
+        return static_cast<const uint32*>(column.data)[row];
+    }
+  }
+
+  // Computes the bitvectors of the row in leaves, one per tree, for all the
+  // trees.
+  void ComputeLeaves(uint row, uint64* leaves) const;
+  inline double GetLeafScore(int tree, const uint64* leaves) const {
+    return leaf_scores_[leaf_offsets_[tree] + __builtin_ctzll(leaves[tree])];
+  }
+
+  uint num_rows_ = 0;
+  vector<Feature> features_;
+  unordered_map<const IntegerizedColumn*, int> feature_indices_;
+  vector<uint64> category_bits_;
+  // Offset of the leaves of each tree in leaf_scores_.
+  vector<int> leaf_offsets_;
+  vector<double> leaf_scores_;
+};
+
+}  // namespace gbdt
+
+#endif  // QUICK_SCORER_H_
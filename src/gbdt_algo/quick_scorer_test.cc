@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <random>
+#include <google/protobuf/text_format.h>
+
+#include "compiled_forest.h"
+#include "quick_scorer.h"
+#include "gtest/gtest.h"
+#include "src/base/base.h"
+#include "src/data_store/column.h"
+#include "src/data_store/data_store.h"
+#include "src/proto/tree.pb.h"
+
+namespace gbdt {
+
+class QuickScorerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    const int kNumRows = 3000;
+    vector<string> colors;
+    vector<float> lengths;
+    vector<float> widths;
+    for (int i = 0; i < kNumRows; ++i) {
+      colors.push_back(kColors[rng_() % kColors.size()]);
+      lengths.push_back(rng_() % 50);
+      widths.push_back(rng_() % 7 == 0 ? NAN : (rng_() % 200) / 10.0);
+    }
+    data_store_.Add(Column::CreateStringColumn("color", colors));
+    data_store_.Add(Column::CreateBucketizedFloatColumn("length", lengths));
+    data_store_.Add(Column::CreateBucketizedFloatColumn("width", widths));
+  }
+
+  // Grows a random tree of num_leaves leaves.
+  void RandomTree(int num_leaves, TreeNode* node) {
+    if (num_leaves == 1) {
+      node->set_score((rng_() % 1000) / 100.0 - 5.0);
+      return;
+    }
+    auto* split = node->mutable_split();
+    switch (rng_() % 3) {
+      case 0:
+        split->set_feature("color");
+        split->mutable_cat_split();
+        for (const auto& color : kColors) {
+          if (rng_() % 2) split->mutable_cat_split()->add_category(color);
+        }
+        break;
+      case 1:
+        split->set_feature("length");
+        split->mutable_float_split()->set_threshold(rng_() % 50 + 0.5);
+        break;
+      default:
+        split->set_feature("width");
+        split->mutable_float_split()->set_threshold((rng_() % 200) / 10.0 + 0.05);
+        split->mutable_float_split()->set_missing_to_right_child(rng_() % 2);
+        break;
+    }
+    int num_left_leaves = 1 + rng_() % (num_leaves - 1);
+    RandomTree(num_left_leaves, node->mutable_left_child());
+    RandomTree(num_leaves - num_left_leaves, node->mutable_right_child());
+  }
+
+  const vector<string> kColors = {"red", "blue", "green", "yellow", "purple"};
+  mt19937 rng_{1};
+  DataStore data_store_;
+};
+
+TEST_F(QuickScorerTest, SameScoresAsCompiledForest) {
+  Forest forest;
+  for (int num_leaves : {1, 2, 5, 32, 64, 17, 63}) {
+    RandomTree(num_leaves, forest.add_tree());
+  }
+  ASSERT_TRUE(QuickScorer::CanScore(forest));
+
+  CompiledForest compiled_forest(forest, &data_store_);
+  QuickScorer quick_scorer(forest, &data_store_);
+  EXPECT_EQ(forest.tree_size(), quick_scorer.num_trees());
+
+  vector<vector<double>> expected_scores;
+  compiled_forest.ScoreCheckpoints({1, 4, 7}, &expected_scores);
+  vector<vector<double>> scores;
+  quick_scorer.ScoreCheckpoints({1, 4, 7}, &scores);
+  EXPECT_EQ(expected_scores, scores);
+
+  vector<double> expected_range_scores(data_store_.num_rows(), 1.0);
+  compiled_forest.AddTreeScores(2, 5, &expected_range_scores);
+  vector<double> range_scores(data_store_.num_rows(), 1.0);
+  quick_scorer.AddTreeScores(2, 5, &range_scores);
+  EXPECT_EQ(expected_range_scores, range_scores);
+}
+
+TEST_F(QuickScorerTest, TooManyLeaves) {
+  Forest forest;
+  RandomTree(64, forest.add_tree());
+  EXPECT_TRUE(QuickScorer::CanScore(forest));
+  RandomTree(65, forest.add_tree());
+  EXPECT_FALSE(QuickScorer::CanScore(forest));
+}
+
+}  // namespace gbdt
@@ -16,79 +16,731 @@
 #include "split_algo.h"
 
 #include <algorithm>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <limits>
 #include <numeric>
 #include <unordered_set>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
 
+#include "histogram_arena.h"
 #include "src/base/base.h"
 #include "src/data_store/column.h"
 #include "src/proto/config.pb.h"
 #include "src/proto/tree.pb.h"
+#include "src/utils/threadpool.h"
 #include "src/utils/vector_slice.h"
 
+DECLARE_int32(num_threads);
+DECLARE_bool(simd_histograms);
+DECLARE_bool(sparse_columns);
+
 using namespace std::placeholders;
 
 namespace gbdt {
 
 const double kFloatTolerance = 1e-6;
+// Relative tolerance used when histograms are computed by subtraction.
+const double kHistogramTolerance = 1e-9;
+
+namespace {
+
+// The difference of two sums over the same samples is not always exactly zero
+// because of rounding errors. Such values would show up as non-empty buckets and
+// move the split points, so they are snapped to zero.
+inline double SubtractWithTolerance(double x, double y) {
+  double diff = x - y;
+  return fabs(diff) <= kHistogramTolerance * fabs(x) ? 0.0 : diff;
+}
 
+// Slices of at least this size are partitioned in parallel, in blocks of
+// kPartitionBlockSize samples.
+const int kParallelPartitionThreshold = 1 << 16;
+const int kPartitionBlockSize = 1 << 14;
+
+// Partitions the samples in a single pass without branches on go_left: every
+// sample is written both to the left cursor in place and to the right cursor in
+// a scratch buffer, and only one of the cursors advances. The left cursor never
+// passes the read position, so the left samples can be written in place. The
+// partition is stable. The gradients of the left samples are summed up into
+// left_total, if not null.
+template <bool kWithGradients, typename INT, typename GoLeft, typename GRADIENT>
+int PartitionSerially(const vector<INT>& col, GoLeft go_left, uint* samples,
+                      GRADIENT* ordered_gradients, int n, GradientData* left_total) {
+  thread_local vector<uint> right_samples;
+  thread_local vector<GRADIENT> right_gradients;
+  right_samples.resize(n);
+  if (kWithGradients) right_gradients.resize(n);
+
+  // Sums of the right and the left gradients.
+  GradientData sums[2];
+  int left_pos = 0;
+  int right_pos = 0;
+  for (int i = 0; i < n; ++i) {
+    uint index = samples[i];
+    int left = go_left(col[index]);
+    samples[left_pos] = index;
+    right_samples[right_pos] = index;
+    if (kWithGradients) {
+      const auto gradient_data = ordered_gradients[i];
+      ordered_gradients[left_pos] = gradient_data;
+      right_gradients[right_pos] = gradient_data;
+      sums[left] += gradient_data;
+    }
+    left_pos += left;
+    right_pos += 1 - left;
+  }
+  if (left_total) *left_total = sums[1];
+  std::copy(right_samples.begin(), right_samples.begin() + right_pos, samples + left_pos);
+  if (kWithGradients) {
+    std::copy(right_gradients.begin(), right_gradients.begin() + right_pos,
+              ordered_gradients + left_pos);
+  }
+  return left_pos;
+}
+
+// Partitions large slices in parallel. Each block of samples evaluates go_left
+// and counts its left samples. A prefix sum over the counts then gives every block
+// its destinations, and the blocks scatter their samples into a scratch buffer
+// that is copied back. The partition is stable, so the result is the same as
+// PartitionSerially and doesn't depend on the number of threads. The left
+// gradients are summed up per block while they are scattered.
+template <bool kWithGradients, typename INT, typename GoLeft, typename GRADIENT>
+int PartitionInParallel(const vector<INT>& col, GoLeft go_left, uint* samples,
+                        GRADIENT* ordered_gradients, int n, GradientData* left_total) {
+  int num_blocks = (n + kPartitionBlockSize - 1) / kPartitionBlockSize;
+  auto block_begin = [n](int block) { return min(block * kPartitionBlockSize, n); };
+  auto* pool = ThreadPool::Get(FLAGS_num_threads);
+
+  vector<uint8> is_left(n);
+  vector<int> left_counts(num_blocks + 1, 0);
+  pool->ParallelFor(num_blocks, [&](int block) {
+      int count = 0;
+      for (int i = block_begin(block); i < block_begin(block + 1); ++i) {
+        is_left[i] = go_left(col[samples[i]]);
+        count += is_left[i];
+      }
+      left_counts[block + 1] = count;
+    });
+  std::partial_sum(left_counts.begin(), left_counts.end(), left_counts.begin());
+  int left_size = left_counts[num_blocks];
+
+  vector<uint> scratch_samples(n);
+  vector<GRADIENT> scratch_gradients(kWithGradients ? n : 0);
+  vector<GradientData> block_left_totals(num_blocks);
+  pool->ParallelFor(num_blocks, [&](int block) {
+      int begin = block_begin(block);
+      // Samples before the block that go right precede the block's right samples.
+      int left_pos = left_counts[block];
+      int right_pos = left_size + begin - left_counts[block];
+      GradientData sums[2];
+      for (int i = begin; i < block_begin(block + 1); ++i) {
+        int left = is_left[i];
+        int pos = left ? left_pos : right_pos;
+        scratch_samples[pos] = samples[i];
+        if (kWithGradients) {
+          scratch_gradients[pos] = ordered_gradients[i];
+          sums[left] += ordered_gradients[i];
+        }
+        left_pos += left;
+        right_pos += 1 - left;
+      }
+      block_left_totals[block] = sums[1];
+    });
+  if (left_total) {
+    // Summed up in the order of the blocks, so the sum doesn't depend on the
+    // number of threads.
+    *left_total = std::accumulate(block_left_totals.begin(), block_left_totals.end(),
+                                  GradientData());
+  }
+  pool->ParallelFor(num_blocks, [&](int block) {
+      int begin = block_begin(block);
+      int end = block_begin(block + 1);
+      std::copy(scratch_samples.begin() + begin, scratch_samples.begin() + end, samples + begin);
+      if (kWithGradients) {
+        std::copy(scratch_gradients.begin() + begin, scratch_gradients.begin() + end,
+                  ordered_gradients + begin);
+      }
+    });
+  return left_size;
+}
+
+// Moves the samples satisfying go_left to the front, keeping the order of both
+// sides. ordered_gradients, if not null, is aligned with samples and permuted
+// along, and the gradients of the left samples are summed up into left_total, if
+// not null. It is compiled for each integer type of the column's raw storage and
+// each storage type of the gradients (GradientData or CompactGradientData).
+template <typename INT, typename GoLeft, typename GRADIENT>
 pair<VectorSlice<uint>, VectorSlice<uint>>
-Partition(const BucketizedFloatColumn* feature, const Split& split, VectorSlice<uint> samples) {
-  CHECK(split.has_float_split()) << "Split and feature type mismatch for " << feature->name();
-  uint left_size = 0;
-  bool missing_to_right = split.float_split().missing_to_right_child();
-  float threshold = split.float_split().threshold();
-  const auto& col = feature->col();
-  for (uint i = 0; i < samples.size(); ++i) {
-    if ((col.missing(samples[i]) && !missing_to_right) ||
-        (!col.missing(samples[i]) && feature->get_row_max(samples[i]) < threshold)) {
-      std::swap(samples[i], samples[left_size++]);
+PartitionOnRawCol(const vector<INT>& col, GoLeft go_left, VectorSlice<uint> samples,
+                  GRADIENT* ordered_gradients, GradientData* left_total) {
+  int n = samples.size();
+  int left_size = 0;
+  if (n > 0) {
+    auto* sample_data = &samples[0];
+    if (n >= kParallelPartitionThreshold) {
+      left_size = ordered_gradients ?
+          PartitionInParallel<true>(col, go_left, sample_data, ordered_gradients, n, left_total) :
+          PartitionInParallel<false>(col, go_left, sample_data, ordered_gradients, n, nullptr);
+    } else {
+      left_size = ordered_gradients ?
+          PartitionSerially<true>(col, go_left, sample_data, ordered_gradients, n, left_total) :
+          PartitionSerially<false>(col, go_left, sample_data, ordered_gradients, n, nullptr);
     }
+  } else if (left_total) {
+    *left_total = GradientData();
   }
   return make_pair(VectorSlice<uint>(samples, 0, left_size),
-                   VectorSlice<uint>(samples, left_size, samples.size() - left_size));
+                   VectorSlice<uint>(samples, left_size, n - left_size));
+}
+
+// Consecutive samples are accumulated round-robin into kNumPartialHistograms
+// partial histograms that are summed up at the end. Runs of samples in the same
+// bucket, which are common on skewed 8/16-bit features, then update different
+// memory instead of waiting on the store of the previous sample. Partial
+// histograms are only used when a node has at least kNumPartialHistograms samples
+// per bucket, so that summing them up costs little compared to the pass over the
+// samples.
+const int kNumPartialHistograms = 4;
+// Distance in samples at which the bins of upcoming rows are prefetched.
+const int kPrefetchDistance = 32;
+
+// Sources of the gradients of the histogram kernels. OrderedGradients reads the
+// weighted gradients aligned with the samples, stored as GradientData or
+// CompactGradientData; IndexedGradients reads the gradients of the rows and
+// weights them with the weight policy (UnitWeights or ArrayWeights).
+template <typename GRADIENT>
+struct OrderedGradients {
+  inline GradientData operator()(int k, uint) const {
+    return data[k];
+  }
+  const GRADIENT* data;
+};
+
+template <typename Weights>
+struct IndexedGradients {
+  inline GradientData operator()(int, uint index) const {
+    return w.Apply(index, data[index]);
+  }
+  Weights w;
+  const GradientData* data;
+};
+
+// Accumulates the gradients of samples [begin, end) into the partial histograms.
+// Sample k always goes to partial histogram k % kNumPartialHistograms.
+template <typename INT, typename Gradients>
+void AccumulatePartialHistograms(const INT* col, const uint* samples, Gradients gradients,
+                                 int begin, int end, GradientData* const* partials) {
+  for (int k = begin; k < end; ++k) {
+    if (k + kPrefetchDistance < end) {
+      __builtin_prefetch(col + samples[k + kPrefetchDistance]);
+    }
+    partials[k % kNumPartialHistograms][col[samples[k]]] += gradients(k, samples[k]);
+  }
+}
+
+#ifdef __x86_64__
+
+#define GBDT_TARGET_AVX2 __attribute__((target("avx2")))
+
+// The AVX2 kernel processes kNumPartialHistograms samples at a time: the bins are
+// gathered from the column, the gradients are loaded or gathered, and each sample
+// is added to its own partial histogram with one 128-bit add of g and h. It adds
+// the same numbers in the same order as the scalar kernel, so the histograms are
+// bit-identical.
+static_assert(kNumPartialHistograms == 4, "The AVX2 kernel processes 4 samples at a time.");
+static_assert(sizeof(GradientData) == 2 * sizeof(double), "GradientData must be g and h.");
+static_assert(sizeof(CompactGradientData) == 2 * sizeof(float),
+              "CompactGradientData must be g and h.");
+
+// Rows up to this index can be gathered: the offsets of the gathers of g and h
+// are 2 * index + 1 in 32 bits.
+const int kMaxGatherRow = (1 << 30) - 1;
+
+GBDT_TARGET_AVX2 inline void LoadGradients(const OrderedGradients<GradientData>& gradients,
+                                           int k, __m128i, __m128d* loaded) {
+  for (int j = 0; j < 4; ++j) {
+    loaded[j] = _mm_loadu_pd(&gradients.data[k + j].g);
+  }
+}
+
+// Widens g and h to double exactly as the conversion to GradientData.
+GBDT_TARGET_AVX2 inline void LoadGradients(
+    const OrderedGradients<CompactGradientData>& gradients, int k, __m128i, __m128d* loaded) {
+  for (int j = 0; j < 4; ++j) {
+    loaded[j] = _mm_cvtps_pd(_mm_castsi128_ps(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&gradients.data[k + j]))));
+  }
+}
+
+// Gathers g and h of the 4 rows. lo holds g and h of rows 0 and 1, hi those of
+// rows 2 and 3.
+GBDT_TARGET_AVX2 inline void GatherGradients(const GradientData* data, __m128i indices,
+                                             __m256d* lo, __m256d* hi) {
+  const __m128i twice = _mm_add_epi32(indices, indices);
+  const __m128i h_offsets = _mm_set_epi32(1, 0, 1, 0);
+  *lo = _mm256_i32gather_pd(&data->g, _mm_add_epi32(_mm_unpacklo_epi32(twice, twice), h_offsets),
+                            sizeof(double));
+  *hi = _mm256_i32gather_pd(&data->g, _mm_add_epi32(_mm_unpackhi_epi32(twice, twice), h_offsets),
+                            sizeof(double));
+}
+
+GBDT_TARGET_AVX2 inline void SplitGradients(__m256d lo, __m256d hi, __m128d* loaded) {
+  loaded[0] = _mm256_castpd256_pd128(lo);
+  loaded[1] = _mm256_extractf128_pd(lo, 1);
+  loaded[2] = _mm256_castpd256_pd128(hi);
+  loaded[3] = _mm256_extractf128_pd(hi, 1);
+}
+
+GBDT_TARGET_AVX2 inline void LoadGradients(const IndexedGradients<UnitWeights>& gradients, int,
+                                           __m128i indices, __m128d* loaded) {
+  __m256d lo, hi;
+  GatherGradients(gradients.data, indices, &lo, &hi);
+  SplitGradients(lo, hi, loaded);
+}
+
+GBDT_TARGET_AVX2 inline void LoadGradients(const IndexedGradients<ArrayWeights>& gradients, int,
+                                           __m128i indices, __m128d* loaded) {
+  __m256d lo, hi;
+  GatherGradients(gradients.data, indices, &lo, &hi);
+  // The float weights are widened to double exactly as in float * GradientData.
+  const __m256d w = _mm256_cvtps_pd(_mm_i32gather_ps(gradients.w.data, indices, sizeof(float)));
+  lo = _mm256_mul_pd(lo, _mm256_permute4x64_pd(w, 0x50));
+  hi = _mm256_mul_pd(hi, _mm256_permute4x64_pd(w, 0xfa));
+  SplitGradients(lo, hi, loaded);
+}
+
+// Returns the number of samples processed, a multiple of 4. The rest is left to
+// the scalar kernel.
+template <typename INT, typename Gradients>
+GBDT_TARGET_AVX2 int AccumulatePartialHistogramsAvx2(const vector<INT>& col,
+                                                     const uint* samples,
+                                                     Gradients gradients,
+                                                     int n,
+                                                     GradientData* const* partials) {
+  // A gather reads 4 bytes at each bin, which runs past the end of 8/16-bit
+  // columns for the last rows. Groups with such rows are left to the scalar kernel.
+  const int64 max_row = min<int64>(static_cast<int64>(col.size()) - 4 / sizeof(INT),
+                                   kMaxGatherRow);
+  if (max_row < 0) return 0;
+  const __m128i limit = _mm_set1_epi32(max_row);
+  const __m128i mask = _mm_set1_epi32(
+      sizeof(INT) == 4 ? -1 : static_cast<int>((1u << (8 * sizeof(INT))) - 1));
+  const int* base = reinterpret_cast<const int*>(col.data());
+
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    for (int j = k + kPrefetchDistance; j < min(k + kPrefetchDistance + 4, n); ++j) {
+      _mm_prefetch(reinterpret_cast<const char*>(col.data() + samples[j]), _MM_HINT_T0);
+    }
+    const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + k));
+    if (!_mm_test_all_ones(_mm_cmpeq_epi32(_mm_max_epu32(indices, limit), limit))) {
+      AccumulatePartialHistograms(col.data(), samples, gradients, k, k + 4, partials);
+      continue;
+    }
+    alignas(16) uint32 bins[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(bins),
+                    _mm_and_si128(_mm_i32gather_epi32(base, indices, sizeof(INT)), mask));
+    __m128d loaded[4];
+    LoadGradients(gradients, k, indices, loaded);
+    for (int j = 0; j < 4; ++j) {
+      double* bucket = &partials[j][bins[j]].g;
+      _mm_storeu_pd(bucket, _mm_add_pd(_mm_loadu_pd(bucket), loaded[j]));
+    }
+  }
+  return k;
+}
+
+#undef GBDT_TARGET_AVX2
+
+#endif  // __x86_64__
+
+bool UseAvx2() {
+#ifdef __x86_64__
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2 && FLAGS_simd_histograms;
+#else
+  return false;
+#endif
+}
+
+// Accumulates the gradients of the samples into the buckets. It is compiled for
+// each integer type of the column's raw storage and for each gradient source.
+template <typename INT, typename Gradients>
+void AccumulateHistograms(const vector<INT>& col,
+                          const VectorSlice<uint>& samples,
+                          Gradients gradients,
+                          vector<GradientData>* histograms) {
+  const int n = samples.size();
+  if (n == 0) return;
+  const uint* sample_data = &samples[0];
+
+  auto* arena = HistogramArena::Get();
+  vector<GradientData> extra_partials[kNumPartialHistograms - 1];
+  GradientData* partials[kNumPartialHistograms];
+  bool use_partials = n >= kNumPartialHistograms * histograms->size();
+  partials[0] = histograms->data();
+  for (int j = 1; j < kNumPartialHistograms; ++j) {
+    if (use_partials) {
+      extra_partials[j - 1] = arena->AllocateHistogram(histograms->size());
+      partials[j] = extra_partials[j - 1].data();
+    } else {
+      // All the samples go to the same histogram in the order of the samples.
+      partials[j] = partials[0];
+    }
+  }
+
+  int k = 0;
+#ifdef __x86_64__
+  if (UseAvx2()) {
+    k = AccumulatePartialHistogramsAvx2(col, sample_data, gradients, n, partials);
+  }
+#endif
+  AccumulatePartialHistograms(col.data(), sample_data, gradients, k, n, partials);
+
+  if (use_partials) {
+    for (auto& partial : extra_partials) {
+      for (uint i = 0; i < histograms->size(); ++i) {
+        (*histograms)[i] += partial[i];
+      }
+      arena->Release(&partial);
+    }
+  }
+}
+
+// Nodes get compact histograms when the feature has at least this many values
+// per sample.
+const int kMinBucketsPerSampleForCompact = 16;
+
+// Samples are matched against the non-missing rows of a sparse feature when there
+// are at least this many samples per non-missing row in their range.
+const int kMinSamplesPerSparseRow = 4;
+
+// Returns whether to work on the non-missing rows of the feature instead of on
+// every sample.
+bool UseSparseIndex(const IntegerizedColumn& feature, const uint* samples, int n) {
+  if (!FLAGS_sparse_columns || !feature.sparse()) return false;
+  const auto& rows = feature.sparse_rows();
+  auto begin = lower_bound(rows.begin(), rows.end(), samples[0]);
+  auto end = upper_bound(begin, rows.end(), samples[n - 1]);
+  return (end - begin) * kMinSamplesPerSparseRow <= n;
+}
+
+// Returns the first position in [pos, n) whose sample is not less than row. It
+// searches with exponentially growing steps from pos, so visiting the rows in
+// ascending order costs O(log(gap)) per row.
+inline int SearchSamples(const uint* samples, int pos, int n, uint row) {
+  int step = 1;
+  int hi = pos;
+  while (hi < n && samples[hi] < row) {
+    pos = hi + 1;
+    hi += step;
+    step <<= 1;
+  }
+  return lower_bound(samples + pos, samples + min(hi, n), row) - samples;
+}
+
+// Calls f(position, value) for each sample that is a non-missing row of the
+// sparse feature. The samples must be in ascending order.
+template <typename Func>
+void VisitNonMissingSamples(const IntegerizedColumn& feature, const uint* samples, int n,
+                            Func f) {
+  const auto& rows = feature.sparse_rows();
+  const auto& values = feature.sparse_values();
+  auto begin = lower_bound(rows.begin(), rows.end(), samples[0]);
+  int pos = 0;
+  for (auto it = begin; it != rows.end() && pos < n; ++it) {
+    pos = SearchSamples(samples, pos, n, *it);
+    if (pos < n && samples[pos] == *it) {
+      f(pos, values[it - rows.begin()]);
+    }
+  }
+}
+
+// Accumulates the non-missing samples of a sparse feature and derives the missing
+// bucket from the total.
+template <typename GRADIENT>
+void AccumulateSparseHistograms(const IntegerizedColumn& feature,
+                                const uint* samples,
+                                const GRADIENT* gradients,
+                                int n,
+                                const GradientData& total,
+                                vector<GradientData>* histograms) {
+  auto* histogram_data = histograms->data();
+  GradientData non_missing;
+  VisitNonMissingSamples(feature, samples, n, [&](int pos, uint value) {
+      const GradientData gradient_data = gradients[pos];
+      histogram_data[value] += gradient_data;
+      non_missing += gradient_data;
+    });
+  histogram_data[0] = GradientData(SubtractWithTolerance(total.g, non_missing.g),
+                                   SubtractWithTolerance(total.h, non_missing.h));
+}
+
+// Partitions the samples of a sparse feature. Only the non-missing samples are
+// routed one by one: those going the other way than the missing rows are set
+// aside, the runs of samples between them are moved in bulk to the side of the
+// missing rows, and the set-aside samples fill the other side. The partition is
+// stable. Only the set-aside gradients are summed up, so the sum of the side of
+// the missing rows is derived from total, the sum of all the gradients.
+template <typename GoLeft, typename GRADIENT>
+int PartitionSparse(const IntegerizedColumn& feature, GoLeft go_left, uint* samples,
+                    GRADIENT* ordered_gradients, int n, const GradientData& total,
+                    GradientData* left_total) {
+  const bool missing_to_left = go_left(0);
+  thread_local vector<int> moved;
+  thread_local vector<uint> moved_samples;
+  thread_local vector<GRADIENT> moved_gradients;
+  moved.clear();
+  moved_samples.clear();
+  moved_gradients.clear();
+  GradientData moved_total;
+  VisitNonMissingSamples(feature, samples, n, [&](int pos, uint value) {
+      if (static_cast<bool>(go_left(value)) != missing_to_left) {
+        moved.push_back(pos);
+        moved_samples.push_back(samples[pos]);
+        if (ordered_gradients) {
+          moved_gradients.push_back(ordered_gradients[pos]);
+          moved_total += ordered_gradients[pos];
+        }
+      }
+    });
+  if (left_total) {
+    *left_total = missing_to_left ? total - moved_total : moved_total;
+  }
+
+  // Moves the range [begin, end) of samples to dest.
+  auto move_run = [&](int begin, int end, int dest) {
+    if (dest < begin) {
+      std::copy(samples + begin, samples + end, samples + dest);
+      if (ordered_gradients) {
+        std::copy(ordered_gradients + begin, ordered_gradients + end, ordered_gradients + dest);
+      }
+    } else if (dest > begin) {
+      std::copy_backward(samples + begin, samples + end, samples + dest + end - begin);
+      if (ordered_gradients) {
+        std::copy_backward(ordered_gradients + begin, ordered_gradients + end,
+                           ordered_gradients + dest + end - begin);
+      }
+    }
+  };
+
+  const int num_moved = moved.size();
+  int moved_begin;
+  if (missing_to_left) {
+    int write = 0;
+    int read = 0;
+    for (auto pos : moved) {
+      move_run(read, pos, write);
+      write += pos - read;
+      read = pos + 1;
+    }
+    move_run(read, n, write);
+    moved_begin = n - num_moved;
+  } else {
+    int write = n;
+    int read = n;
+    for (int j = num_moved - 1; j >= 0; --j) {
+      write -= read - moved[j] - 1;
+      move_run(moved[j] + 1, read, write);
+      read = moved[j];
+    }
+    move_run(0, read, write - read);
+    moved_begin = 0;
+  }
+  std::copy(moved_samples.begin(), moved_samples.end(), samples + moved_begin);
+  if (ordered_gradients) {
+    std::copy(moved_gradients.begin(), moved_gradients.end(), ordered_gradients + moved_begin);
+  }
+  return missing_to_left ? n - num_moved : num_moved;
+}
+
+// Partitions the samples of the feature, in bulk if the feature is sparse and the
+// samples are in ascending order. total is the sum of ordered_gradients and is
+// only read when left_total is not null.
+template <typename GoLeft, typename GRADIENT>
+pair<VectorSlice<uint>, VectorSlice<uint>>
+PartitionFeature(const IntegerizedColumn& feature, GoLeft go_left, VectorSlice<uint> samples,
+                 GRADIENT* ordered_gradients, const GradientData& total,
+                 GradientData* left_total) {
+  int n = samples.size();
+  if (n > 0 && UseSparseIndex(feature, &samples[0], n) &&
+      is_sorted(samples.begin(), samples.end())) {
+    int left_size = PartitionSparse(feature, go_left, &samples[0], ordered_gradients, n, total,
+                                    left_total);
+    return make_pair(VectorSlice<uint>(samples, 0, left_size),
+                     VectorSlice<uint>(samples, left_size, n - left_size));
+  }
+  return feature.VisitRawCol([&](const auto& col) {
+      return PartitionOnRawCol(col, go_left, samples, ordered_gradients, left_total);
+    });
+}
+
+// Accumulates quantized gradients into integer sums of type SUM (int32 or int64),
+// interleaved as g and h of each bucket, and rescales the sums into the
+// histograms.
+template <typename SUM, typename INT, typename QUANTIZED>
+void AccumulateQuantizedHistograms(const vector<INT>& col,
+                                   const VectorSlice<uint>& samples,
+                                   const QUANTIZED* gradients,
+                                   const GradientData& scale,
+                                   vector<GradientData>* histograms) {
+  thread_local vector<SUM> sums;
+  sums.assign(2 * histograms->size(), 0);
+  auto* sum_data = sums.data();
+  int k = 0;
+  for (auto index : samples) {
+    auto* sum = sum_data + 2 * col[index];
+    sum[0] += gradients[k].g;
+    sum[1] += gradients[k].h;
+    ++k;
+  }
+  for (uint i = 0; i < histograms->size(); ++i) {
+    if (sums[2 * i] != 0 || sums[2 * i + 1] != 0) {
+      (*histograms)[i] = GradientData(sums[2 * i] * scale.g, sums[2 * i + 1] * scale.h);
+    }
+  }
+}
+
+}  // namespace
+
+template <typename GRADIENT>
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const BucketizedFloatColumn* feature, const Split& split, VectorSlice<uint> samples,
+          GRADIENT* ordered_gradients, const GradientData& total, GradientData* left_total) {
+  CHECK(split.has_float_split()) << "Split and feature type mismatch for " << feature->name();
+  bool missing_to_left = !split.float_split().missing_to_right_child();
+  // Routes on the bucket ids, so that a row costs an integer compare instead of a
+  // lookup of the bucket max.
+  uint bucket_threshold = split.float_split().internal_bucket_threshold();
+  if (bucket_threshold == 0) {
+    bucket_threshold = feature->get_bucket_threshold(split.float_split().threshold());
+  }
+  // Bucket 0 represents missing.
+  auto go_left = [missing_to_left, bucket_threshold](uint value) {
+    return value == 0 ? missing_to_left : value < bucket_threshold;
+  };
+  return PartitionFeature(*feature, go_left, samples, ordered_gradients, total, left_total);
 }
 
+template <typename GRADIENT>
 pair<VectorSlice<uint>, VectorSlice<uint>>
-Partition(const StringColumn* feature, const Split& split, VectorSlice<uint> samples) {
+Partition(const StringColumn* feature, const Split& split, VectorSlice<uint> samples,
+          GRADIENT* ordered_gradients, const GradientData& total, GradientData* left_total) {
   CHECK(split.has_cat_split()) << "Split and feature type mismatch for " << feature->name();
-  // TODO(criver): converting repeated fields everytime seems wasteful. Rewrite this if protobuf
-  // has better support for set. However, this is arguably not so bad, since this is done at
-  // per-node level not the per-instance level.
-  unordered_set<uint> categories;
+  CategoryBitset categories(*feature, split);
+  auto go_left = [&categories](uint value) {
+    return categories.Contains(value);
+  };
+  return PartitionFeature(*feature, go_left, samples, ordered_gradients, total, left_total);
+}
+
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const StringColumn* feature, const CategoryBitset& categories,
+          VectorSlice<uint> samples) {
+  auto go_left = [&categories](uint value) {
+    return categories.Contains(value);
+  };
+  return PartitionFeature(*feature, go_left, samples, static_cast<GradientData*>(nullptr),
+                          GradientData(), nullptr);
+}
+
+CategoryBitset::CategoryBitset(const StringColumn& feature, const Split& split)
+    : bits_((feature.max_int() + 63) / 64, 0) {
+  auto add = [this](uint cat_index) {
+    bits_[cat_index >> 6] |= uint64(1) << (cat_index & 63);
+  };
   if (split.cat_split().internal_categorical_index_size() > 0) {
-    categories.insert(split.cat_split().internal_categorical_index().begin(),
-                      split.cat_split().internal_categorical_index().end());
+    for (auto cat_index : split.cat_split().internal_categorical_index()) {
+      add(cat_index);
+    }
   } else {
     for (const auto& cat: split.cat_split().category()) {
       uint cat_index;
-      if (feature->get_cat_index(cat, &cat_index)) {
-        categories.insert(cat_index);
+      if (feature.get_cat_index(cat, &cat_index)) {
+        add(cat_index);
       }
     }
   }
-
-  const auto& col = feature->col();
-  uint left_size = 0;
-  for (uint i = 0; i < samples.size(); ++i) {
-    if (categories.find(col[samples[i]]) != categories.end())
-      std::swap(samples[i], samples[left_size++]);
-  }
-  return make_pair(VectorSlice<uint>(samples, 0, left_size),
-                   VectorSlice<uint>(samples, left_size, samples.size() - left_size));
 }
 
+template <typename GRADIENT>
 pair<VectorSlice<uint>, VectorSlice<uint>>
-Partition(const Column* feature, const Split& split, VectorSlice<uint> samples) {
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          GRADIENT* ordered_gradients, const GradientData& total, GradientData* left_total) {
   if (feature->type() == Column::kStringColumn) {
-    return Partition(static_cast<const StringColumn*>(feature), split, samples);
+    return Partition(static_cast<const StringColumn*>(feature), split, samples,
+                     ordered_gradients, total, left_total);
   } else if (feature->type() == Column::kBucketizedFloatColumn) {
-    return Partition(static_cast<const BucketizedFloatColumn*>(feature), split, samples);
+    return Partition(static_cast<const BucketizedFloatColumn*>(feature), split, samples,
+                     ordered_gradients, total, left_total);
   } else {
+    if (left_total) *left_total = GradientData();
     return make_pair(VectorSlice<uint>(samples, 0, 0), VectorSlice<uint>(samples));
   }
 }
 
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples) {
+  return Partition(feature, split, samples, static_cast<GradientData*>(nullptr), GradientData(),
+                   nullptr);
+}
+
+template <typename GRADIENT>
+pair<VectorSlice<uint>, VectorSlice<uint>>
+PartitionWithOrderedGradients(const Column* feature, const Split& split,
+                              VectorSlice<uint> samples,
+                              VectorSlice<GRADIENT> ordered_gradients,
+                              const GradientData& total,
+                              pair<GradientData, GradientData>* totals) {
+  CHECK_EQ(samples.size(), ordered_gradients.size())
+      << "Ordered gradients are not aligned with the samples.";
+  GradientData left_total;
+  auto slices = Partition(feature, split, samples,
+                          samples.size() > 0 ? &ordered_gradients[0] : nullptr, total,
+                          totals ? &left_total : nullptr);
+  if (totals) {
+    *totals = make_pair(left_total, total - left_total);
+  }
+  return slices;
+}
+
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<GradientData> ordered_gradients,
+          const GradientData& total, pair<GradientData, GradientData>* totals) {
+  return PartitionWithOrderedGradients(feature, split, samples, ordered_gradients, total,
+                                       totals);
+}
+
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<CompactGradientData> ordered_gradients,
+          const GradientData& total, pair<GradientData, GradientData>* totals) {
+  return PartitionWithOrderedGradients(feature, split, samples, ordered_gradients, total,
+                                       totals);
+}
+
+template <typename INT>
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<QuantizedGradientData<INT>> ordered_gradients,
+          const GradientData& total, pair<GradientData, GradientData>* totals) {
+  return PartitionWithOrderedGradients(feature, split, samples, ordered_gradients, total,
+                                       totals);
+}
+
+template pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<QuantizedGradientData<int8>> ordered_gradients,
+          const GradientData& total, pair<GradientData, GradientData>* totals);
+template pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<QuantizedGradientData<int16>> ordered_gradients,
+          const GradientData& total, pair<GradientData, GradientData>* totals);
+
 Histogram::Histogram(const IntegerizedColumn& feature,
                      FloatVector w,
                      const vector<GradientData>& gradient_data_vec,
@@ -96,26 +748,243 @@ Histogram::Histogram(const IntegerizedColumn& feature,
   ComputeHistograms(feature, w, gradient_data_vec, samples);
 }
 
+Histogram::Histogram(const IntegerizedColumn& feature,
+                     const VectorSlice<uint>& samples,
+                     const VectorSlice<GradientData>& ordered_gradients) {
+  ComputeOrderedHistograms(feature, samples, ordered_gradients, nullptr);
+}
+
+Histogram::Histogram(const IntegerizedColumn& feature,
+                     const VectorSlice<uint>& samples,
+                     const VectorSlice<CompactGradientData>& ordered_gradients) {
+  ComputeOrderedHistograms(feature, samples, ordered_gradients, nullptr);
+}
+
+Histogram::Histogram(const IntegerizedColumn& feature,
+                     const VectorSlice<uint>& samples,
+                     const VectorSlice<GradientData>& ordered_gradients,
+                     const GradientData& total) {
+  ComputeOrderedHistograms(feature, samples, ordered_gradients, &total);
+}
+
+Histogram::Histogram(const IntegerizedColumn& feature,
+                     const VectorSlice<uint>& samples,
+                     const VectorSlice<CompactGradientData>& ordered_gradients,
+                     const GradientData& total) {
+  ComputeOrderedHistograms(feature, samples, ordered_gradients, &total);
+}
+
+template <typename INT>
+Histogram::Histogram(const IntegerizedColumn& feature,
+                     const VectorSlice<uint>& samples,
+                     const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+                     const GradientData& scale) {
+  CHECK_EQ(samples.size(), ordered_gradients.size())
+      << "Ordered gradients are not aligned with the samples.";
+  histograms_ = HistogramArena::Get()->AllocateHistogram(feature.max_int());
+  const auto* gradients = samples.size() > 0 ? &ordered_gradients[0] : nullptr;
+  // 32-bit sums can't overflow even if every sample has the largest magnitude.
+  bool use_int32 = static_cast<int64>(samples.size()) * numeric_limits<INT>::max() <=
+      numeric_limits<int32>::max();
+  feature.VisitRawCol([&](const auto& col) {
+      if (use_int32) {
+        AccumulateQuantizedHistograms<int32>(col, samples, gradients, scale, &histograms_);
+      } else {
+        AccumulateQuantizedHistograms<int64>(col, samples, gradients, scale, &histograms_);
+      }
+    });
+
+  ComputeNonZeroValues();
+}
+
+template Histogram::Histogram(const IntegerizedColumn& feature,
+                              const VectorSlice<uint>& samples,
+                              const VectorSlice<QuantizedGradientData<int8>>& ordered_gradients,
+                              const GradientData& scale);
+template Histogram::Histogram(const IntegerizedColumn& feature,
+                              const VectorSlice<uint>& samples,
+                              const VectorSlice<QuantizedGradientData<int16>>& ordered_gradients,
+                              const GradientData& scale);
+
+template <typename GRADIENT>
+void Histogram::ComputeOrderedHistograms(const IntegerizedColumn& feature,
+                                         const VectorSlice<uint>& samples,
+                                         const VectorSlice<GRADIENT>& ordered_gradients,
+                                         const GradientData* total) {
+  CHECK_EQ(samples.size(), ordered_gradients.size())
+      << "Ordered gradients are not aligned with the samples.";
+  const int n = samples.size();
+  const auto* gradients = n > 0 ? &ordered_gradients[0] : nullptr;
+  if (static_cast<int64>(n) * kMinBucketsPerSampleForCompact <= feature.max_int()) {
+    ComputeCompactHistograms(feature, samples, gradients);
+    return;
+  }
+
+  histograms_ = HistogramArena::Get()->AllocateHistogram(feature.max_int());
+  if (total && n > 0 && UseSparseIndex(feature, &samples[0], n)) {
+    DCHECK(is_sorted(samples.begin(), samples.end())) << "Samples are not in ascending order.";
+    AccumulateSparseHistograms(feature, &samples[0], gradients, n, *total, &histograms_);
+  } else {
+    feature.VisitRawCol([&](const auto& col) {
+        AccumulateHistograms(col, samples, OrderedGradients<GRADIENT>{gradients}, &histograms_);
+      });
+  }
+
+  ComputeNonZeroValues();
+}
+
+template <typename GRADIENT>
+void Histogram::ComputeCompactHistograms(const IntegerizedColumn& feature,
+                                         const VectorSlice<uint>& samples,
+                                         const GRADIENT* ordered_gradients) {
+  // Sorts the samples by value and then by position, so that each bucket sums
+  // up its samples in the same order as the dense histogram.
+  thread_local vector<uint64> keys;
+  keys.clear();
+  feature.VisitRawCol([&](const auto& col) {
+      uint64 pos = 0;
+      for (auto index : samples) {
+        keys.push_back(static_cast<uint64>(col[index]) << 32 | pos++);
+      }
+    });
+  sort(keys.begin(), keys.end());
+
+  thread_local vector<pair<uint, GradientData>> buckets;
+  buckets.clear();
+  for (auto key : keys) {
+    uint value = key >> 32;
+    if (buckets.empty() || buckets.back().first != value) {
+      buckets.emplace_back(value, GradientData());
+    }
+    buckets.back().second += ordered_gradients[static_cast<uint32>(key)];
+  }
+  SetCompactHistograms(buckets);
+}
+
+void Histogram::SetCompactHistograms(const vector<pair<uint, GradientData>>& buckets) {
+  compact_ = true;
+  missing_ = GradientData();
+  HistogramArena::Get()->Release(&histograms_);
+  HistogramArena::Get()->Release(&non_zero_values_);
+  histograms_ = HistogramArena::Get()->AllocateHistogram(0);
+  histograms_.reserve(buckets.size());
+  non_zero_values_ = HistogramArena::Get()->AllocateValues(buckets.size());
+  for (const auto& bucket : buckets) {
+    if (bucket.first == 0) {
+      missing_ = bucket.second;
+    }
+    if (bucket.second.g != 0 && bucket.second.h != 0) {
+      non_zero_values_.push_back(bucket.first);
+      histograms_.push_back(bucket.second);
+    }
+  }
+}
+
+Histogram::Histogram(const Histogram& parent, const Histogram& sibling) {
+  if (parent.compact_) {
+    // Subtracts the sibling's buckets from a sorted copy of the parent's.
+    thread_local vector<pair<uint, GradientData>> buckets;
+    buckets.clear();
+    if (parent.HasMissingValue()) {
+      buckets.emplace_back(0, parent.DataOnMissing());
+    }
+    for (int i = 0; i < parent.size(); ++i) {
+      if (parent.value(i) != 0) {
+        buckets.emplace_back(parent.value(i), parent.data(i));
+      }
+    }
+    sort(buckets.begin(), buckets.end(),
+         [](const pair<uint, GradientData>& x, const pair<uint, GradientData>& y) {
+           return x.first < y.first;
+         });
+    int num_parent_buckets = buckets.size();
+    auto subtract = [&](uint value, const GradientData& y) {
+      auto end = buckets.begin() + num_parent_buckets;
+      auto it = lower_bound(buckets.begin(), end, value,
+                            [](const pair<uint, GradientData>& x, uint value) {
+                              return x.first < value;
+                            });
+      if (it != end && it->first == value) {
+        it->second = GradientData(SubtractWithTolerance(it->second.g, y.g),
+                                  SubtractWithTolerance(it->second.h, y.h));
+      } else {
+        buckets.emplace_back(value, GradientData() - y);
+      }
+    };
+    if (sibling.HasMissingValue()) {
+      subtract(0, sibling.DataOnMissing());
+    }
+    for (int i = 0; i < sibling.size(); ++i) {
+      if (sibling.value(i) != 0) {
+        subtract(sibling.value(i), sibling.data(i));
+      }
+    }
+    if (buckets.size() > num_parent_buckets) {
+      sort(buckets.begin(), buckets.end(),
+           [](const pair<uint, GradientData>& x, const pair<uint, GradientData>& y) {
+             return x.first < y.first;
+           });
+    }
+    SetCompactHistograms(buckets);
+    return;
+  }
+
+  histograms_ = HistogramArena::Get()->AllocateHistogram(parent.histograms_.size());
+  std::copy(parent.histograms_.begin(), parent.histograms_.end(), histograms_.begin());
+  auto subtract = [this](uint value, const GradientData& y) {
+    auto& x = histograms_[value];
+    x.g = SubtractWithTolerance(x.g, y.g);
+    x.h = SubtractWithTolerance(x.h, y.h);
+  };
+  if (sibling.compact_) {
+    subtract(0, sibling.missing_);
+    for (int i = 0; i < sibling.size(); ++i) {
+      if (sibling.value(i) != 0) {
+        subtract(sibling.value(i), sibling.data(i));
+      }
+    }
+  } else {
+    CHECK_EQ(parent.histograms_.size(), sibling.histograms_.size())
+        << "Histograms are computed on different features.";
+    for (uint i = 0; i < histograms_.size(); ++i) {
+      subtract(i, sibling.histograms_[i]);
+    }
+  }
+  ComputeNonZeroValues();
+}
+
+Histogram::Histogram(vector<GradientData>&& histograms)
+    : histograms_(std::move(histograms)) {
+  ComputeNonZeroValues();
+}
+
+Histogram::~Histogram() {
+  HistogramArena::Get()->Release(&histograms_);
+  HistogramArena::Get()->Release(&non_zero_values_);
+}
+
 // This is the main work horse of the whole algorithm. Please make sure
 // it is written in an efficient way.
 void Histogram::ComputeHistograms(const IntegerizedColumn& feature,
                                   FloatVector w,
                                   const vector<GradientData>& gradient_data_vec,
                                   const VectorSlice<uint>& samples) {
-  uint max_int = feature.max_int();
-  histograms_.resize(max_int);
-  non_zero_values_.reserve(max_int);
-  const auto& col = feature.col();
-  // Compute histograms.
-  for(auto index : samples) {
-    auto& histogram = histograms_[col[index]];
-    const auto& weight = w(index);
-    const auto& gradient_data = gradient_data_vec[index];
-    histogram.g += weight * gradient_data.g;
-    histogram.h += weight * gradient_data.h;
-  }
-
-  for (uint i = 0; i < max_int; ++i) {
+  histograms_ = HistogramArena::Get()->AllocateHistogram(feature.max_int());
+  feature.VisitRawCol([&](const auto& col) {
+      w.Visit([&](auto weights) {
+          AccumulateHistograms(col, samples,
+                               IndexedGradients<decltype(weights)>{weights, gradient_data_vec.data()},
+                               &histograms_);
+        });
+    });
+
+  ComputeNonZeroValues();
+}
+
+void Histogram::ComputeNonZeroValues() {
+  HistogramArena::Get()->Release(&non_zero_values_);
+  non_zero_values_ = HistogramArena::Get()->AllocateValues(histograms_.size());
+  for (uint i = 0; i < histograms_.size(); ++i) {
     if (histograms_[i].g != 0 && histograms_[i].h != 0) {
       non_zero_values_.push_back(i);
     }
@@ -123,16 +992,34 @@ void Histogram::ComputeHistograms(const IntegerizedColumn& feature,
 }
 
 bool Histogram::HasMissingValue() const {
-  // IntegerizedColumn put 0 as the missing value.
-  return histograms_[0].g != 0 || histograms_[0].h != 0;
+  const auto& data_on_missing = DataOnMissing();
+  return data_on_missing.g != 0 || data_on_missing.h != 0;
 }
 
 const GradientData& Histogram::DataOnMissing() const {
   // IntegerizedColumn put 0 as the missing value.
-  return histograms_[0];
+  return compact_ ? missing_ : histograms_[0];
 }
 
 void Histogram::SortOnNodeScore(double lambda) {
+  if (compact_) {
+    thread_local vector<pair<uint, GradientData>> buckets;
+    buckets.clear();
+    for (int i = 0; i < size(); ++i) {
+      buckets.emplace_back(value(i), data(i));
+    }
+    // Same sort as below on the same sequence, so ties end up in the same order.
+    sort(buckets.begin(), buckets.end(),
+                [lambda](const pair<uint, GradientData>& x, const pair<uint, GradientData>& y) {
+                  return x.second.Score(lambda) < y.second.Score(lambda);
+                });
+    for (int i = 0; i < size(); ++i) {
+      non_zero_values_[i] = buckets[i].first;
+      histograms_[i] = buckets[i].second;
+    }
+    return;
+  }
+
   // Compare the Node Score.
   auto compare_node_score = [](uint x, uint y,
                                const vector<GradientData>* histograms, double lambda) {
@@ -142,6 +1029,11 @@ void Histogram::SortOnNodeScore(double lambda) {
   sort(non_zero_values_.begin(), non_zero_values_.end(), std::bind(compare_node_score, _1, _2, &histograms_, lambda));
 }
 
+size_t Histogram::memory_size() const {
+  return histograms_.capacity() * sizeof(GradientData) +
+      non_zero_values_.capacity() * sizeof(uint);
+}
+
 // Data structure for holding the split.
 struct SplitPoint {
   int left_point = -1;
@@ -205,14 +1097,10 @@ bool FindBestSplitPoint(const IntegerizedColumn& feature,
 // then we iterate over [0, num_unique_values) to find the best split
 // point. The time complexity is O(n+num_unique_values).
 bool FindBestFloatSplit(const BucketizedFloatColumn& feature,
-                        FloatVector w,
-                        const vector<GradientData>* gradient_data_vec,
-                        const VectorSlice<uint>& samples,
+                        const Histogram& histogram,
                         const Config& config,
                         const GradientData& total,
                         Split* split) {
-  Histogram histogram(feature, w, *gradient_data_vec, samples);
-
   SplitPoint split_point;
   if (!FindBestSplitPoint(feature, config, histogram, total, true, &split_point)) {
     return false;
@@ -229,36 +1117,35 @@ bool FindBestFloatSplit(const BucketizedFloatColumn& feature,
   split->mutable_float_split()->set_threshold(
       isnan(left_limit) ? feature.get_bucket_min(1) - 1e-3 :
       (left_limit + right_limit) / 2.0);
+  split->mutable_float_split()->set_internal_bucket_threshold(
+      feature.get_bucket_threshold(split->float_split().threshold()));
   return true;
 }
 
 bool FindBestStringSplit(const StringColumn& feature,
-                         FloatVector w,
-                         const vector<GradientData>* gradient_data_vec,
-                         const VectorSlice<uint>& samples,
+                         Histogram* histogram,
                          const Config& config,
                          const GradientData& total,
                          Split* split) {
-  Histogram histogram(feature, w, *gradient_data_vec, samples);
   // For categorical features, since there is no preset order, we can
   // sort them based on their node scores and find the optimal subset.
-  histogram.SortOnNodeScore(config.l2_lambda());
+  histogram->SortOnNodeScore(config.l2_lambda());
 
   SplitPoint split_point;
-  if (!FindBestSplitPoint(feature, config, histogram, total, false, &split_point)) {
+  if (!FindBestSplitPoint(feature, config, *histogram, total, false, &split_point)) {
     return false;
   }
 
   split->set_gain(split_point.gain);
   // Construct the set of values. Always put the smaller set on the left.
   auto* cat_split = split->mutable_cat_split();
-  if (split_point.left_point + 1 <= histogram.size() - split_point.left_point - 1) {
+  if (split_point.left_point + 1 <= histogram->size() - split_point.left_point - 1) {
     for (uint i = 0; i <= split_point.left_point; ++i) {
-      cat_split->add_internal_categorical_index(histogram.value(i));
+      cat_split->add_internal_categorical_index(histogram->value(i));
     }
   } else {
-    for (uint i = split_point.left_point + 1; i < histogram.size(); ++i) {
-      cat_split->add_internal_categorical_index(histogram.value(i));
+    for (uint i = split_point.left_point + 1; i < histogram->size(); ++i) {
+      cat_split->add_internal_categorical_index(histogram->value(i));
     }
   }
 
@@ -272,13 +1159,27 @@ bool FindBestSplit(const Column* feature,
                    const Config& config,
                    const GradientData& total,
                    Split* split) {
+  if (feature->type() != Column::kStringColumn &&
+      feature->type() != Column::kBucketizedFloatColumn) {
+    return false;
+  }
+  Histogram histogram(static_cast<const IntegerizedColumn&>(*feature),
+                      w, *gradient_data_vec, samples);
+  return FindBestSplit(feature, &histogram, config, total, split);
+}
+
+bool FindBestSplit(const Column* feature,
+                   Histogram* histogram,
+                   const Config& config,
+                   const GradientData& total,
+                   Split* split) {
   switch (feature->type()) {
     case Column::kStringColumn:
       return FindBestStringSplit(static_cast<const StringColumn&>(*feature),
-                                 w, gradient_data_vec, samples, config, total, split);
+                                 histogram, config, total, split);
     case Column::kBucketizedFloatColumn:
       return FindBestFloatSplit(static_cast<const BucketizedFloatColumn&>(*feature),
-                                w, gradient_data_vec, samples, config, total, split);
+                                *histogram, config, total, split);
     default:
       return false;
   }
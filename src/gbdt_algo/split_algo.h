@@ -30,43 +30,157 @@ namespace gbdt {
 class Column;
 class IntegerizedColumn;
 class Split;
+class StringColumn;
 class Config;
 
 // Histogram contains weighted sums of gradients and hessians
 // for each bucktized feature values.
+//
+// A histogram is either dense, indexed by the integerized values of the feature,
+// or compact, holding only the non-empty buckets. Nodes with far fewer samples
+// than values of the feature get compact histograms, which cost O(n log n)
+// instead of O(max_int).
 class Histogram {
  public:
   Histogram(const IntegerizedColumn& feature,
             FloatVector w,
             const vector<GradientData>& gradient_data_vec,
             const VectorSlice<uint>& samples);
+  // Same as above but reads the weighted gradients from ordered_gradients, which
+  // is aligned with the samples, so that the gradients are read sequentially.
+  Histogram(const IntegerizedColumn& feature,
+            const VectorSlice<uint>& samples,
+            const VectorSlice<GradientData>& ordered_gradients);
+  Histogram(const IntegerizedColumn& feature,
+            const VectorSlice<uint>& samples,
+            const VectorSlice<CompactGradientData>& ordered_gradients);
+  // Same as above but derives the missing bucket as total minus the other buckets.
+  // On a sparse feature, only the non-missing rows among the samples are visited
+  // when that is cheaper than a pass over the samples. The samples must be in
+  // ascending order.
+  Histogram(const IntegerizedColumn& feature,
+            const VectorSlice<uint>& samples,
+            const VectorSlice<GradientData>& ordered_gradients,
+            const GradientData& total);
+  Histogram(const IntegerizedColumn& feature,
+            const VectorSlice<uint>& samples,
+            const VectorSlice<CompactGradientData>& ordered_gradients,
+            const GradientData& total);
+  // Same as above but for gradients quantized in units of scale. The buckets are
+  // accumulated with integer adds and rescaled once at the end, so the histogram
+  // doesn't depend on the order of the samples. INT is int8 or int16.
+  template <typename INT>
+  Histogram(const IntegerizedColumn& feature,
+            const VectorSlice<uint>& samples,
+            const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+            const GradientData& scale);
+  // Computes the histogram of a node as the difference between the histograms of its
+  // parent and its sibling. It costs O(max_int), or O(k log k) when the parent is
+  // compact with k buckets, instead of a pass over the samples.
+  Histogram(const Histogram& parent, const Histogram& sibling);
+  // Takes the dense histogram indexed by the integerized values of the feature, e.g.
+  // computed by BinMatrix. The buffer is preferably allocated from HistogramArena.
+  explicit Histogram(vector<GradientData>&& histograms);
+  // Returns the buffers to the HistogramArena of the calling thread.
+  ~Histogram();
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
   inline int size() const {
     return non_zero_values_.size();
   }
   inline const GradientData& data(int i) const {
-    return histograms_[value(i)];
+    return compact_ ? histograms_[i] : histograms_[value(i)];
   }
   inline const uint value(int i) const {
     return non_zero_values_[i];
   }
   bool HasMissingValue() const;
-  inline const GradientData& DataOnMissing() const;
+  const GradientData& DataOnMissing() const;
 
   void SortOnNodeScore(double lambda);
 
+  // Memory footprint of the histogram in bytes.
+  size_t memory_size() const;
+
  private:
   void ComputeHistograms(const IntegerizedColumn& feature,
                          FloatVector w,
                          const vector<GradientData>& gradient_data,
                          const VectorSlice<uint>& samples);
+  // total is null if it is not known.
+  template <typename GRADIENT>
+  void ComputeOrderedHistograms(const IntegerizedColumn& feature,
+                                const VectorSlice<uint>& samples,
+                                const VectorSlice<GRADIENT>& ordered_gradients,
+                                const GradientData* total);
+  template <typename GRADIENT>
+  void ComputeCompactHistograms(const IntegerizedColumn& feature,
+                                const VectorSlice<uint>& samples,
+                                const GRADIENT* ordered_gradients);
+  // Sets the compact histogram from buckets sorted by value.
+  void SetCompactHistograms(const vector<pair<uint, GradientData>>& buckets);
+  void ComputeNonZeroValues();
+  // Dense: indexed by value. Compact: aligned with non_zero_values_.
   vector<GradientData> histograms_;
   vector<uint> non_zero_values_;
+  bool compact_ = false;
+  // The missing bucket of a compact histogram.
+  GradientData missing_;
+};
+
+// CategoryBitset is a categorical split compiled into a dense bitset indexed by the
+// category ids of the feature, so that routing a row is a single bit test.
+class CategoryBitset {
+ public:
+  CategoryBitset(const StringColumn& feature, const Split& split);
+  inline bool Contains(uint cat_index) const {
+    return (bits_[cat_index >> 6] >> (cat_index & 63)) & 1;
+  }
+  // Words of the bitset, 64 categories each.
+  inline const vector<uint64>& bits() const {
+    return bits_;
+  }
+
+ private:
+  vector<uint64> bits_;
 };
 
-// Partitions samples into left and right according to the split.
+// Partitions samples into left and right according to the split. On a sparse
+// feature with samples in ascending order, the missing rows are moved in bulk.
 pair<VectorSlice<uint>, VectorSlice<uint>>
 Partition(const Column* feature, const Split& split, VectorSlice<uint> samples);
 
+// Same as above but also applies the permutation to ordered_gradients, which is
+// aligned with samples, so that they stay aligned. The first left.size()
+// gradients then belong to the left samples and the rest to the right samples.
+//
+// If totals is not null, the sums of the left and the right gradients are
+// computed in the same pass and returned in totals, which saves the passes over
+// the children. total must then be the sum of ordered_gradients. The sums are in
+// the units of ordered_gradients, i.e. of the scale for quantized gradients.
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<GradientData> ordered_gradients,
+          const GradientData& total = GradientData(),
+          pair<GradientData, GradientData>* totals = nullptr);
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<CompactGradientData> ordered_gradients,
+          const GradientData& total = GradientData(),
+          pair<GradientData, GradientData>* totals = nullptr);
+template <typename INT>
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const Column* feature, const Split& split, VectorSlice<uint> samples,
+          VectorSlice<QuantizedGradientData<INT>> ordered_gradients,
+          const GradientData& total = GradientData(),
+          pair<GradientData, GradientData>* totals = nullptr);
+
+// Same as above but routes on a categorical split compiled beforehand, which
+// saves compiling it on every call.
+pair<VectorSlice<uint>, VectorSlice<uint>>
+Partition(const StringColumn* feature, const CategoryBitset& categories,
+          VectorSlice<uint> samples);
+
 // Finds the best split for a feature. Returns false on failure.
 //
 // 1. For both float and strings features, the algorithm has complexity of O(n + k), where
@@ -81,6 +195,14 @@ bool FindBestSplit(const Column* feature,
                    const GradientData& total,
                    Split* split);
 
+// Same as above but uses the precomputed histogram of the feature on the samples.
+// The order of the values in the histogram may be changed.
+bool FindBestSplit(const Column* feature,
+                   Histogram* histogram,
+                   const Config& config,
+                   const GradientData& total,
+                   Split* split);
+
 }  // namespace gbdt
 
 #endif  // SPLIT_ALGO_H_
@@ -3,6 +3,9 @@
 
 #include "split_algo.h"
 
+#include <gflags/gflags.h>
+#include <numeric>
+#include <random>
 #include <set>
 #include <string>
 #include <unordered_set>
@@ -14,6 +17,9 @@
 #include "src/proto/config.pb.h"
 #include "src/proto/tree.pb.h"
 
+DECLARE_bool(simd_histograms);
+DECLARE_bool(sparse_columns);
+
 namespace gbdt {
 
 class FindSplitPointTest : public ::testing::Test {
@@ -28,8 +34,8 @@ class FindSplitPointTest : public ::testing::Test {
   vector<GradientData> gradient_data_vec_ = {
     {-1, 1}, {-2, 1}, {2, 1}, {-1, 1}, {-2, 1}, {3, 1}, {2, 1}, {3, 1}, {0, 1}, {-2, 1}};
   vector<float> weights_ = {0.1, 0.1, 0.1, 0.2, 0.1, 0.1, 0.1, 0.2, 0.1, 0.1};
-  FloatVector w_ = [this](int i) { return weights_[i]; };
-  FloatVector constant_weight_ = [](int i) { return 1.0; };
+  FloatVector w_ = FloatVector(weights_);
+  FloatVector constant_weight_;
   vector<uint> samples_ = {0, 2, 3, 4, 1, 5, 7, 6};
   GradientData total_;
 };
@@ -172,6 +178,182 @@ TEST_F(FindSplitPointTest, IrrelevantFeature) {
   EXPECT_FALSE(split.has_float_split());
 }
 
+TEST_F(FindSplitPointTest, HistogramSubtraction) {
+  auto feature = Column::CreateBucketizedFloatColumn(
+      "foo", vector<float>({1, 3, NAN, 3, 1, 7, 5, 7, 3, 5}));
+  const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+  vector<uint> left_samples = {0, 2, 3, 4};
+  vector<uint> right_samples = {1, 5, 7, 6};
+
+  Histogram parent(integerized_feature, w_, gradient_data_vec_, samples_);
+  Histogram left(integerized_feature, w_, gradient_data_vec_, left_samples);
+  Histogram right(integerized_feature, w_, gradient_data_vec_, right_samples);
+  Histogram right_by_subtraction(parent, left);
+
+  ASSERT_EQ(right.size(), right_by_subtraction.size());
+  for (int i = 0; i < right.size(); ++i) {
+    EXPECT_EQ(right.value(i), right_by_subtraction.value(i));
+    EXPECT_FLOAT_EQ(right.data(i).g, right_by_subtraction.data(i).g);
+    EXPECT_FLOAT_EQ(right.data(i).h, right_by_subtraction.data(i).h);
+  }
+  EXPECT_FALSE(right_by_subtraction.HasMissingValue());
+}
+
+TEST_F(FindSplitPointTest, HistogramWithUnitWeights) {
+  auto feature = Column::CreateBucketizedFloatColumn(
+      "foo", vector<float>({1, 3, NAN, 3, 1, 7, 5, 7, 3, 5}));
+  const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+
+  Histogram unit(integerized_feature, constant_weight_, gradient_data_vec_, samples_);
+  Histogram ones(integerized_feature, FloatVector(vector<float>(weights_.size(), 1.0)),
+                 gradient_data_vec_, samples_);
+
+  ASSERT_EQ(ones.size(), unit.size());
+  for (int i = 0; i < ones.size(); ++i) {
+    EXPECT_EQ(ones.value(i), unit.value(i));
+    EXPECT_EQ(ones.data(i).g, unit.data(i).g);
+    EXPECT_EQ(ones.data(i).h, unit.data(i).h);
+  }
+}
+
+TEST_F(FindSplitPointTest, HistogramKernelsAreBitIdentical) {
+  // Skewed 8-bit and 16-bit features on enough samples to use the partial
+  // histograms, with the samples in random order and including the last rows.
+  const int n = 50000;
+  vector<float> small_values(n);
+  vector<float> large_values(n);
+  vector<GradientData> gradient_data_vec(n);
+  vector<float> weights(n);
+  for (int i = 0; i < n; ++i) {
+    small_values[i] = i % 5 == 0 ? i % 100 : 0;
+    large_values[i] = i % 5 == 0 ? i % 10000 : 0;
+    gradient_data_vec[i] = GradientData(sin(i), 1 + cos(i) / 2);
+    weights[i] = 1.0 / (1 + i % 7);
+  }
+  vector<uint> samples(n);
+  iota(samples.begin(), samples.end(), 0);
+  shuffle(samples.begin(), samples.end(), std::mt19937(1));
+  samples.resize(n - 3);
+  vector<GradientData> ordered_gradients;
+  vector<CompactGradientData> compact_gradients;
+  for (auto index : samples) {
+    ordered_gradients.push_back(weights[index] * gradient_data_vec[index]);
+    compact_gradients.emplace_back(ordered_gradients.back());
+  }
+
+  for (const auto* values : {&small_values, &large_values}) {
+    auto feature = Column::CreateBucketizedFloatColumn("foo", *values);
+    const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+    vector<unique_ptr<Histogram>> histograms[2];
+    bool old_simd = FLAGS_simd_histograms;
+    for (int simd = 0; simd < 2; ++simd) {
+      FLAGS_simd_histograms = simd;
+      histograms[simd].emplace_back(
+          new Histogram(integerized_feature, FloatVector(weights), gradient_data_vec, samples));
+      histograms[simd].emplace_back(
+          new Histogram(integerized_feature, FloatVector(), gradient_data_vec, samples));
+      histograms[simd].emplace_back(
+          new Histogram(integerized_feature, samples, ordered_gradients));
+      histograms[simd].emplace_back(
+          new Histogram(integerized_feature, samples, compact_gradients));
+    }
+    FLAGS_simd_histograms = old_simd;
+
+    for (int j = 0; j < histograms[0].size(); ++j) {
+      const auto& scalar = *histograms[0][j];
+      const auto& simd = *histograms[1][j];
+      ASSERT_EQ(scalar.size(), simd.size());
+      for (int i = 0; i < scalar.size(); ++i) {
+        EXPECT_EQ(scalar.value(i), simd.value(i));
+        EXPECT_EQ(scalar.data(i).g, simd.data(i).g);
+        EXPECT_EQ(scalar.data(i).h, simd.data(i).h);
+      }
+    }
+    // The weighted gradients are the same either way.
+    for (int i = 0; i < histograms[0][0]->size(); ++i) {
+      EXPECT_EQ(histograms[0][0]->data(i).g, histograms[0][2]->data(i).g);
+    }
+  }
+}
+
+TEST_F(FindSplitPointTest, HistogramWithQuantizedGradients) {
+  auto feature = Column::CreateBucketizedFloatColumn(
+      "foo", vector<float>({1, 3, NAN, 3, 1, 7, 5, 7, 3, 5}));
+  const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+  GradientData scale(0.5, 0.25);
+  vector<QuantizedGradientData<int8>> quantized(samples_.size());
+  vector<GradientData> ordered_gradients;
+  for (uint k = 0; k < samples_.size(); ++k) {
+    quantized[k].g = gradient_data_vec_[samples_[k]].g * 3;
+    quantized[k].h = k + 1;
+    ordered_gradients.emplace_back(quantized[k].g * scale.g, quantized[k].h * scale.h);
+  }
+
+  Histogram expected(integerized_feature, samples_, ordered_gradients);
+  Histogram histogram(integerized_feature, samples_,
+                      VectorSlice<QuantizedGradientData<int8>>(quantized), scale);
+  ASSERT_EQ(expected.size(), histogram.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected.value(i), histogram.value(i));
+    EXPECT_EQ(expected.data(i).g, histogram.data(i).g);
+    EXPECT_EQ(expected.data(i).h, histogram.data(i).h);
+  }
+}
+
+TEST_F(FindSplitPointTest, CompactHistograms) {
+  // Far more values than samples, so the histograms on the samples are compact.
+  const int n = 5000;
+  vector<float> values(n);
+  vector<GradientData> gradient_data_vec(n);
+  for (int i = 0; i < n; ++i) {
+    values[i] = i % 7 == 0 ? NAN : i;
+    gradient_data_vec[i] = GradientData(i % 5 - 2, 1 + i % 3);
+  }
+  auto feature = Column::CreateBucketizedFloatColumn("foo", values, 1000);
+  const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+  vector<uint> parent_samples;
+  vector<uint> left_samples;
+  for (int i = 0; i < 60; ++i) {
+    parent_samples.push_back(i * 71 % n);
+    if (i % 2 == 0) left_samples.push_back(parent_samples.back());
+  }
+
+  auto ordered = [&](const vector<uint>& samples) {
+    vector<GradientData> ordered_gradients;
+    for (auto index : samples) ordered_gradients.push_back(gradient_data_vec[index]);
+    return ordered_gradients;
+  };
+  auto expect_eq = [](const Histogram& expected, const Histogram& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      EXPECT_EQ(expected.value(i), actual.value(i));
+      EXPECT_EQ(expected.data(i).g, actual.data(i).g);
+      EXPECT_EQ(expected.data(i).h, actual.data(i).h);
+    }
+    EXPECT_EQ(expected.HasMissingValue(), actual.HasMissingValue());
+    EXPECT_EQ(expected.DataOnMissing().g, actual.DataOnMissing().g);
+  };
+
+  auto parent_gradients = ordered(parent_samples);
+  auto left_gradients = ordered(left_samples);
+  Histogram dense_parent(integerized_feature, FloatVector(), gradient_data_vec, parent_samples);
+  Histogram dense_left(integerized_feature, FloatVector(), gradient_data_vec, left_samples);
+  Histogram compact_parent(integerized_feature, parent_samples, parent_gradients);
+  Histogram compact_left(integerized_feature, left_samples, left_gradients);
+  expect_eq(dense_parent, compact_parent);
+  expect_eq(dense_left, compact_left);
+
+  // Subtraction from compact and dense parents.
+  Histogram dense_right(dense_parent, dense_left);
+  expect_eq(dense_right, Histogram(compact_parent, compact_left));
+  expect_eq(dense_right, Histogram(compact_parent, dense_left));
+  expect_eq(dense_right, Histogram(dense_parent, compact_left));
+
+  dense_parent.SortOnNodeScore(1.0);
+  compact_parent.SortOnNodeScore(1.0);
+  expect_eq(dense_parent, compact_parent);
+}
+
 class PartitionTest : public ::testing::Test {
  protected:
   void SetUp() {
@@ -215,6 +397,23 @@ TEST_F(PartitionTest, PartitionStringColumnString) {
 }
 
 
+TEST_F(PartitionTest, CategoryBitset) {
+  const auto& feature = static_cast<const StringColumn&>(*feature0_);
+  Split split;
+  split.mutable_cat_split()->add_category("red");
+  split.mutable_cat_split()->add_category("yellow");
+  split.mutable_cat_split()->add_category("purple");
+  CategoryBitset categories(feature, split);
+  for (uint i = 0; i < feature.max_int(); ++i) {
+    const auto& cat = feature.get_cat_string(i);
+    EXPECT_EQ(cat == "red" || cat == "yellow", categories.Contains(i)) << cat;
+  }
+
+  auto slices = Partition(&feature, categories, samples_);
+  EXPECT_EQ(set<uint>({0, 1, 4, 6}), SliceToSet(slices.first));
+  EXPECT_EQ(set<uint>({2, 3, 5, 7}), SliceToSet(slices.second));
+}
+
 TEST_F(PartitionTest, PartitionStringColumnPartial) {
   Split split;
   // Red and green.
@@ -234,6 +433,18 @@ TEST_F(PartitionTest, PartitionFloatColumn) {
   EXPECT_EQ(set<uint>({2, 0, 6, 7}), SliceToSet(slices.second));
 }
 
+TEST_F(PartitionTest, PartitionFloatColumnOnBucketThreshold) {
+  // feature1_ has values 0 to 7 in buckets 1 to 8. Values below 3.5 are in the
+  // buckets below 5.
+  EXPECT_EQ(5, static_cast<const BucketizedFloatColumn*>(feature1_.get())->
+            get_bucket_threshold(3.5));
+  Split split;
+  split.mutable_float_split()->set_internal_bucket_threshold(5);
+  auto slices = Partition(feature1_.get(), split, samples_);
+  EXPECT_EQ(set<uint>({1, 3, 4, 5 }), SliceToSet(slices.first));
+  EXPECT_EQ(set<uint>({2, 0, 6, 7}), SliceToSet(slices.second));
+}
+
 TEST_F(PartitionTest, PartitionFloatColumnPartial) {
   Split split;
   split.mutable_float_split()->set_threshold(3.5);
@@ -259,4 +470,123 @@ TEST_F(PartitionTest, PartitionFloatColumnWithMissing) {
   EXPECT_EQ(set<uint>({0, 3, 1, 2, 4, 5}), SliceToSet(slices.second));
 }
 
+TEST_F(PartitionTest, PartitionWithOrderedGradients) {
+  Split split;
+  split.mutable_float_split()->set_threshold(3.5);
+  // The gradient of sample i is {i, 1}.
+  vector<GradientData> ordered_gradients;
+  for (auto index : samples_) {
+    ordered_gradients.emplace_back(index, 1);
+  }
+  VectorSlice<uint> samples(samples_, 2, 4);
+  VectorSlice<GradientData> gradients(ordered_gradients, 2, 4);
+  pair<GradientData, GradientData> totals;
+  auto slices = Partition(feature1_.get(), split, samples, gradients, GradientData(14, 4),
+                          &totals);
+  EXPECT_EQ(set<uint>({3, 4, 5}), SliceToSet(slices.first));
+  EXPECT_EQ(set<uint>({2}), SliceToSet(slices.second));
+  for (int i = 0; i < samples_.size(); ++i) {
+    EXPECT_EQ(samples_[i], ordered_gradients[i].g) << " at " << i;
+  }
+  EXPECT_EQ(12, totals.first.g);
+  EXPECT_EQ(3, totals.first.h);
+  EXPECT_EQ(2, totals.second.g);
+  EXPECT_EQ(1, totals.second.h);
+}
+
+TEST_F(PartitionTest, PartitionLargeSlice) {
+  // Large enough to be partitioned in parallel.
+  const int n = 300000;
+  vector<float> values(n);
+  for (int i = 0; i < n; ++i) {
+    values[i] = i % 3 == 0 ? NAN : (i * 7) % 10;
+  }
+  auto feature = Column::CreateBucketizedFloatColumn("large", values);
+  Split split;
+  split.mutable_float_split()->set_threshold(4.5);
+  vector<uint> samples(n);
+  vector<GradientData> ordered_gradients;
+  GradientData total;
+  for (int i = 0; i < n; ++i) {
+    samples[i] = n - 1 - i;
+    ordered_gradients.emplace_back(samples[i], 1);
+    total += ordered_gradients.back();
+  }
+  pair<GradientData, GradientData> totals;
+  auto slices = Partition(feature.get(), split, samples, ordered_gradients, total, &totals);
+
+  // Both sides keep the order of the samples.
+  vector<uint> expected_left;
+  vector<uint> expected_right;
+  for (int i = n - 1; i >= 0; --i) {
+    (i % 3 == 0 || (i * 7) % 10 < 4.5 ? expected_left : expected_right).push_back(i);
+  }
+  EXPECT_EQ(expected_left, vector<uint>(slices.first.begin(), slices.first.end()));
+  EXPECT_EQ(expected_right, vector<uint>(slices.second.begin(), slices.second.end()));
+  for (int i = 0; i < n; ++i) {
+    ASSERT_EQ(samples[i], ordered_gradients[i].g) << " at " << i;
+  }
+  // The sums of the sides, computed in the same pass, are exact on integers.
+  EXPECT_EQ(accumulate(expected_left.begin(), expected_left.end(), 0.0), totals.first.g);
+  EXPECT_EQ(expected_left.size(), totals.first.h);
+  EXPECT_EQ(accumulate(expected_right.begin(), expected_right.end(), 0.0), totals.second.g);
+  EXPECT_EQ(expected_right.size(), totals.second.h);
+}
+
+TEST_F(PartitionTest, SparseHistogramAndPartition) {
+  const int n = 10000;
+  vector<float> values(n, NAN);
+  for (int i = 0; i < n; i += 97) {
+    values[i] = i % 5;
+  }
+  auto feature = Column::CreateBucketizedFloatColumn("sparse", values);
+  const auto& integerized_feature = static_cast<const IntegerizedColumn&>(*feature);
+  ASSERT_TRUE(integerized_feature.sparse());
+
+  vector<uint> samples;
+  vector<GradientData> ordered_gradients;
+  GradientData total;
+  for (int i = 0; i < n; i += 1 + i % 3) {
+    samples.push_back(i);
+    ordered_gradients.emplace_back(i % 7 - 3, 1);
+    total += ordered_gradients.back();
+  }
+
+  // The missing bucket is derived from the total.
+  Histogram dense(integerized_feature, samples, ordered_gradients);
+  Histogram sparse(integerized_feature, samples, ordered_gradients, total);
+  ASSERT_EQ(dense.size(), sparse.size());
+  for (int i = 0; i < dense.size(); ++i) {
+    EXPECT_EQ(dense.value(i), sparse.value(i));
+    EXPECT_DOUBLE_EQ(dense.data(i).g, sparse.data(i).g);
+    EXPECT_DOUBLE_EQ(dense.data(i).h, sparse.data(i).h);
+  }
+
+  for (bool missing_to_right : {false, true}) {
+    Split split;
+    split.mutable_float_split()->set_threshold(1.5);
+    split.mutable_float_split()->set_missing_to_right_child(missing_to_right);
+    auto expected_samples = samples;
+    auto expected_gradients = ordered_gradients;
+    pair<GradientData, GradientData> expected_totals;
+    FLAGS_sparse_columns = false;
+    auto expected = Partition(feature.get(), split, expected_samples, expected_gradients, total,
+                              &expected_totals);
+    FLAGS_sparse_columns = true;
+    auto actual_samples = samples;
+    auto actual_gradients = ordered_gradients;
+    pair<GradientData, GradientData> actual_totals;
+    auto actual = Partition(feature.get(), split, actual_samples, actual_gradients, total,
+                            &actual_totals);
+    EXPECT_EQ(expected.first.size(), actual.first.size());
+    EXPECT_EQ(expected_totals.first.g, actual_totals.first.g);
+    EXPECT_EQ(expected_totals.first.h, actual_totals.first.h);
+    EXPECT_EQ(expected_totals.second.g, actual_totals.second.g);
+    EXPECT_EQ(expected_samples, actual_samples);
+    for (uint i = 0; i < samples.size(); ++i) {
+      ASSERT_EQ(expected_gradients[i].g, actual_gradients[i].g) << " at " << i;
+    }
+  }
+}
+
 }  // namespace gbdt
@@ -18,11 +18,17 @@
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
 #include <queue>
 #include <tuple>
+#include <unordered_map>
 
 #include "external/cppformat/format.h"
 
+#include "bin_matrix.h"
 #include "split_algo.h"
 #include "src/base/base.h"
 #include "src/data_store/column.h"
@@ -35,64 +41,414 @@
 #include "src/utils/vector_slice.h"
 
 DECLARE_int32(num_threads);
+DECLARE_int32(histogram_cache_mb);
+DECLARE_bool(compact_gradients);
 
 using namespace std::placeholders;
 
 namespace gbdt {
 
-GradientData ComputeWeightedSum(FloatVector w,
-                                const vector<GradientData>& gradient_data_vec,
-                                const VectorSlice<uint>& samples) {
-  // Divide samples into slices to parallelize the computation.
-  auto slices = Subsampling::DivideSamples(samples, FLAGS_num_threads * 5);
-  vector<GradientData> totals(slices.size());
-
-  {
-    ThreadPool pool(FLAGS_num_threads);
-    for (int i = 0; i < slices.size(); ++i) {
-      pool.Enqueue([w=w, &slice=slices[i], &total=totals[i], &gradient_data_vec]() {
-          for (auto index : slice) {
-            total += w(index) * gradient_data_vec[index];
+// Gathers the weighted gradients of the samples into a buffer aligned with the
+// samples. Partition keeps the buffer aligned, so that the histograms of the
+// nodes read the gradients sequentially instead of at random positions. The
+// buffer stores GRADIENT, which is GradientData or CompactGradientData.
+template <typename GRADIENT>
+vector<GRADIENT> GatherGradients(FloatVector w,
+                                 const vector<GradientData>& gradient_data_vec,
+                                 const vector<uint>& samples) {
+  vector<GRADIENT> ordered_gradients(samples.size());
+  auto slices = Subsampling::DivideSamples(samples.size(), FLAGS_num_threads * 5);
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices.size(), [&](int i) {
+      w.Visit([&](auto weights) {
+          for (uint k = slices[i].first; k < slices[i].second; ++k) {
+            auto index = samples[k];
+            ordered_gradients[k] = GRADIENT(weights.Apply(index, gradient_data_vec[index]));
           }
         });
+    });
+  return ordered_gradients;
+}
+
+// Samples the rows of a tree. With GOSS, the weights of the rows sampled from the
+// small gradients are amplified, so that the sums of the gradients stay unbiased,
+// and w is replaced by the amplified weights.
+vector<uint> SubsampleRows(const vector<GradientData>& gradient_data_vec,
+                           const Config& config,
+                           FloatVector* w) {
+  if (config.goss_top_rate() <= 0) {
+    return Subsampling::UniformSubsample(gradient_data_vec.size(),
+                                         config.example_sampling_rate());
+  }
+  vector<double> magnitudes(gradient_data_vec.size());
+  for (uint i = 0; i < magnitudes.size(); ++i) {
+    magnitudes[i] = fabs((*w)(i) * gradient_data_vec[i].g);
+  }
+  vector<uint> others;
+  auto samples = Subsampling::GossSubsample(magnitudes, config.goss_top_rate(),
+                                            config.goss_other_rate(), &others);
+  if (!others.empty()) {
+    vector<float> amplified_w(gradient_data_vec.size());
+    for (uint i = 0; i < amplified_w.size(); ++i) {
+      amplified_w[i] = (*w)(i);
     }
+    float amplification = (1 - config.goss_top_rate()) / config.goss_other_rate();
+    for (auto index : others) {
+      amplified_w[index] *= amplification;
+    }
+    *w = FloatVector(std::move(amplified_w));
   }
+  return samples;
+}
+
+// Mixes the bits of x (the finalizer of splitmix64).
+inline uint64 MixBits(uint64 x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Quantizes the weighted gradients of the samples into a buffer aligned with the
+// samples. g and h are scaled separately so that their largest magnitudes map to
+// the largest value of INT. With stochastic rounding, a value is rounded up with
+// the probability of its fractional part, using a hash of the row, so that the
+// result doesn't depend on the number of threads.
+template <typename INT>
+vector<QuantizedGradientData<INT>> QuantizeGradients(FloatVector w,
+                                                     const vector<GradientData>& gradient_data_vec,
+                                                     const vector<uint>& samples,
+                                                     bool stochastic_rounding,
+                                                     GradientData* scale) {
+  auto weighted = GatherGradients<GradientData>(w, gradient_data_vec, samples);
+  auto slices = Subsampling::DivideSamples(samples.size(), FLAGS_num_threads * 5);
+  vector<GradientData> max_abs(slices.size());
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices.size(), [&](int i) {
+      for (uint k = slices[i].first; k < slices[i].second; ++k) {
+        max_abs[i].g = max(max_abs[i].g, fabs(weighted[k].g));
+        max_abs[i].h = max(max_abs[i].h, fabs(weighted[k].h));
+      }
+    });
+  GradientData largest;
+  for (const auto& m : max_abs) {
+    largest.g = max(largest.g, m.g);
+    largest.h = max(largest.h, m.h);
+  }
+  const double max_int = numeric_limits<INT>::max();
+  scale->g = largest.g > 0 ? largest.g / max_int : 1.0;
+  scale->h = largest.h > 0 ? largest.h / max_int : 1.0;
+
+  const uint64 seed = (*Subsampling::get_generator())();
+  auto quantize = [&](double value, double unit, uint64 hash) {
+    double x = value / unit;
+    double rounded = stochastic_rounding ?
+        floor(x + static_cast<double>(hash >> 11) * (1.0 / (uint64(1) << 53))) : round(x);
+    return static_cast<INT>(max(-max_int, min(max_int, rounded)));
+  };
+  vector<QuantizedGradientData<INT>> quantized(samples.size());
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices.size(), [&](int i) {
+      for (uint k = slices[i].first; k < slices[i].second; ++k) {
+        uint64 hash = MixBits(seed ^ samples[k]);
+        quantized[k].g = quantize(weighted[k].g, scale->g, hash);
+        quantized[k].h = quantize(weighted[k].h, scale->h, MixBits(hash));
+      }
+    });
+  return quantized;
+}
+
+// Builds the ordered gradients stored as GRADIENT. scale is the unit of the
+// stored gradients, which is 1 unless they are quantized.
+template <typename GRADIENT>
+void MakeOrderedGradients(FloatVector w,
+                          const vector<GradientData>& gradient_data_vec,
+                          const vector<uint>& samples,
+                          const Config& config,
+                          vector<GRADIENT>* ordered_gradients,
+                          GradientData* scale) {
+  *ordered_gradients = GatherGradients<GRADIENT>(w, gradient_data_vec, samples);
+  *scale = GradientData(1.0, 1.0);
+}
+
+template <typename INT>
+void MakeOrderedGradients(FloatVector w,
+                          const vector<GradientData>& gradient_data_vec,
+                          const vector<uint>& samples,
+                          const Config& config,
+                          vector<QuantizedGradientData<INT>>* ordered_gradients,
+                          GradientData* scale) {
+  *ordered_gradients = QuantizeGradients<INT>(w, gradient_data_vec, samples,
+                                              config.stochastic_rounding(), scale);
+}
+
+// Sums the ordered gradients in their units.
+template <typename GRADIENT>
+GradientData ComputeWeightedSum(const VectorSlice<GRADIENT>& ordered_gradients) {
+  // Divide samples into slices to parallelize the computation.
+  auto slices = Subsampling::DivideSamples(ordered_gradients.size(), FLAGS_num_threads * 5);
+  vector<GradientData> totals(slices.size());
+
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices.size(), [&](int i) {
+      auto& total = totals[i];
+      for (uint k = slices[i].first; k < slices[i].second; ++k) {
+        total += ordered_gradients[k];
+      }
+    });
 
   return std::accumulate(totals.begin(), totals.end(), GradientData());
 }
 
+// Sums the quantized gradients exactly in integers.
+template <typename INT>
+GradientData ComputeWeightedSum(const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients) {
+  auto slices = Subsampling::DivideSamples(ordered_gradients.size(), FLAGS_num_threads * 5);
+  vector<pair<int64, int64>> totals(slices.size());
+
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices.size(), [&](int i) {
+      auto& total = totals[i];
+      for (uint k = slices[i].first; k < slices[i].second; ++k) {
+        total.first += ordered_gradients[k].g;
+        total.second += ordered_gradients[k].h;
+      }
+    });
+
+  int64 g = 0;
+  int64 h = 0;
+  for (const auto& total : totals) {
+    g += total.first;
+    h += total.second;
+  }
+  return GradientData(g, h);
+}
+
+// Converts a sum of ordered gradients in their units into a sum of gradients.
+inline GradientData Rescale(const GradientData& sum, const GradientData& scale) {
+  return GradientData(sum.g * scale.g, sum.h * scale.h);
+}
+
+template <typename GRADIENT>
 struct NodeData {
   NodeData(TreeNode* node_in, const Column* feature_in,
-           VectorSlice<uint> subsamples_in)
-      : node(node_in), feature(feature_in), subsamples(subsamples_in) {}
+           VectorSlice<uint> subsamples_in, VectorSlice<GRADIENT> gradients_in,
+           const GradientData& sum_in)
+      : node(node_in), feature(feature_in), subsamples(subsamples_in),
+        gradients(gradients_in), sum(sum_in) {}
   TreeNode* node;
   const Column* feature;
   // Slices of samples that are routed to the node.
   VectorSlice<uint> subsamples;
+  // Weighted gradients aligned with subsamples.
+  VectorSlice<GRADIENT> gradients;
+  // Sum of the gradients in their units.
+  GradientData sum;
 };
 
-// Finds the best split for the samples.
-pair<Split, const Column*> FindBestFeatureAndSplit(const vector<const Column*>& features,
-                                                   FloatVector w,
-                                                   const vector<GradientData>& gradient_data_vec,
-                                                   const VectorSlice<uint>& samples,
-                                                   const GradientData& total,
-                                                   const Config& config) {
-  vector<uint> sample_features = Subsampling::UniformSubsample(
-      features.size(), config.feature_sampling_rate());
-  vector<Split> splits(sample_features.size());
-  {
+// Histograms of a node indexed by feature. Features that are not sampled at the
+// node have no histograms.
+typedef vector<unique_ptr<Histogram>> NodeHistograms;
 
-    ThreadPool pool(FLAGS_num_threads);
+// HistogramCache keeps the histograms of the nodes waiting to be expanded, so that
+// the histogram of the larger child can be computed as the parent's minus the
+// smaller child's. The cache is bounded by FLAGS_histogram_cache_mb. When it is
+// full, the histograms of the node with the lowest gain are dropped first, since
+// that node is the least likely to be expanded.
+class HistogramCache {
+ public:
+  HistogramCache(size_t capacity) : capacity_(capacity) {}
+
+  void Add(const TreeNode* node, NodeHistograms&& histograms) {
+    size_t size = MemorySize(histograms);
+    if (size > capacity_) return;
+    while (size_ + size > capacity_) {
+      auto lowest = entries_.begin();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->first->split().gain() < lowest->first->split().gain()) {
+          lowest = it;
+        }
+      }
+      size_ -= MemorySize(lowest->second);
+      entries_.erase(lowest);
+    }
+    size_ += size;
+    entries_[node] = std::move(histograms);
+  }
+
+  // Removes the histograms of the node from the cache and returns them. Returns
+  // empty histograms if the node is not in the cache.
+  NodeHistograms Release(const TreeNode* node) {
+    NodeHistograms histograms;
+    auto it = entries_.find(node);
+    if (it != entries_.end()) {
+      size_ -= MemorySize(it->second);
+      histograms = std::move(it->second);
+      entries_.erase(it);
+    }
+    return histograms;
+  }
+
+ private:
+  static size_t MemorySize(const NodeHistograms& histograms) {
+    size_t size = 0;
+    for (const auto& histogram : histograms) {
+      if (histogram) size += histogram->memory_size();
+    }
+    return size;
+  }
+
+  size_t capacity_;
+  size_t size_ = 0;
+  unordered_map<const TreeNode*, NodeHistograms> entries_;
+};
+
+inline bool HasHistogram(const NodeHistograms* histograms, uint feature_index) {
+  return histograms && feature_index < histograms->size() && (*histograms)[feature_index];
+}
 
-    for (uint i = 0; i < sample_features.size(); ++i) {
-      pool.Enqueue([&,i] () {
-          FindBestSplit(features[sample_features[i]], w, &gradient_data_vec, samples,
-                        config, total, &splits[i]);
+// Computes the histogram of a feature, or those of the features of a block of the
+// bin matrix, from the ordered gradients of a node whose gradients sum up to
+// total. scale is only used by quantized gradients.
+template <typename GRADIENT>
+Histogram* ComputeFeatureHistogram(const IntegerizedColumn& feature,
+                                   const VectorSlice<uint>& samples,
+                                   const VectorSlice<GRADIENT>& ordered_gradients,
+                                   const GradientData& scale,
+                                   const GradientData& total) {
+  return new Histogram(feature, samples, ordered_gradients, total);
+}
+
+template <typename INT>
+Histogram* ComputeFeatureHistogram(const IntegerizedColumn& feature,
+                                   const VectorSlice<uint>& samples,
+                                   const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+                                   const GradientData& scale,
+                                   const GradientData& total) {
+  return new Histogram(feature, samples, ordered_gradients, scale);
+}
+
+template <typename GRADIENT>
+void ComputeBlockHistograms(const BinMatrix& bin_matrix,
+                            int block,
+                            const vector<uint>& feature_indices,
+                            const VectorSlice<uint>& samples,
+                            const VectorSlice<GRADIENT>& ordered_gradients,
+                            const GradientData& scale,
+                            vector<vector<GradientData>>* histograms) {
+  bin_matrix.ComputeHistograms(block, feature_indices, samples, ordered_gradients, histograms);
+}
+
+template <typename INT>
+void ComputeBlockHistograms(const BinMatrix& bin_matrix,
+                            int block,
+                            const vector<uint>& feature_indices,
+                            const VectorSlice<uint>& samples,
+                            const VectorSlice<QuantizedGradientData<INT>>& ordered_gradients,
+                            const GradientData& scale,
+                            vector<vector<GradientData>>* histograms) {
+  bin_matrix.ComputeHistograms(block, feature_indices, samples, ordered_gradients, scale,
+                               histograms);
+}
+
+// The histograms of the features of a node to compute. parent and sibling hold
+// the histograms of the parent and the sibling of the node, if known.
+template <typename GRADIENT>
+struct HistogramJob {
+  const vector<uint>* feature_indices;
+  VectorSlice<uint> samples;
+  VectorSlice<GRADIENT> ordered_gradients;
+  GradientData total;
+  const NodeHistograms* parent;
+  const NodeHistograms* sibling;
+  NodeHistograms* histograms;
+};
+
+// Computes the histograms of the features on the samples of the nodes. When both
+// the parent's and the sibling's histograms of a feature are available, the
+// histogram is computed by subtraction instead of a pass over the samples.
+// Otherwise, features bundled in the same block of the bin matrix share one pass
+// over the samples, and one task sweeps a block for all the nodes.
+template <typename GRADIENT>
+void ComputeHistograms(const vector<const Column*>& features,
+                       const vector<HistogramJob<GRADIENT>>& jobs,
+                       const GradientData& scale,
+                       const BinMatrix* bin_matrix) {
+  // Features bundled in the bin matrix, grouped by node and block.
+  vector<unordered_map<int, vector<uint>>> block_features(jobs.size());
+  // Nodes and features computed one by one.
+  vector<pair<int, uint>> other_features;
+  for (int j = 0; j < jobs.size(); ++j) {
+    const auto& job = jobs[j];
+    job.histograms->resize(features.size());
+    for (auto i : *job.feature_indices) {
+      int block = bin_matrix ? bin_matrix->block_of(i) : -1;
+      if (block >= 0 && !(HasHistogram(job.parent, i) && HasHistogram(job.sibling, i))) {
+        block_features[j][block].push_back(i);
+      } else {
+        other_features.emplace_back(j, i);
+      }
+    }
+  }
+  // Nodes with several features in each block.
+  map<int, vector<int>> block_nodes;
+  for (int j = 0; j < jobs.size(); ++j) {
+    for (const auto& p : block_features[j]) {
+      // A single feature is faster to scan from its own column.
+      if (p.second.size() == 1) {
+        other_features.emplace_back(j, p.second[0]);
+      } else {
+        block_nodes[p.first].push_back(j);
+      }
+    }
+  }
+
+  TaskGroup group(ThreadPool::Get(FLAGS_num_threads));
+  for (const auto& p : block_nodes) {
+    group.Run([&, block=p.first, &nodes=p.second]() {
+        for (auto j : nodes) {
+          const auto& job = jobs[j];
+          const auto& block_indices = block_features[j].at(block);
+          vector<vector<GradientData>> block_histograms;
+          ComputeBlockHistograms(*bin_matrix, block, block_indices, job.samples,
+                                 job.ordered_gradients, scale, &block_histograms);
+          for (uint k = 0; k < block_indices.size(); ++k) {
+            (*job.histograms)[block_indices[k]].reset(
+                new Histogram(std::move(block_histograms[k])));
+          }
+        }
+      });
+  }
+  for (const auto& p : other_features) {
+    const auto& job = jobs[p.first];
+    auto i = p.second;
+    const auto* feature = features[i];
+    if (feature->type() != Column::kStringColumn &&
+        feature->type() != Column::kBucketizedFloatColumn) {
+      continue;
+    }
+    auto* histogram = &(*job.histograms)[i];
+    if (HasHistogram(job.parent, i) && HasHistogram(job.sibling, i)) {
+      group.Run([histogram, &parent=(*job.parent)[i], &sibling=(*job.sibling)[i]]() {
+          histogram->reset(new Histogram(*parent, *sibling));
+        });
+    } else {
+      group.Run([&, histogram, feature]() {
+          histogram->reset(ComputeFeatureHistogram(static_cast<const IntegerizedColumn&>(*feature),
+                                                   job.samples, job.ordered_gradients, scale,
+                                                   job.total));
         });
     }
   }
+  group.Wait();
+}
+
+// The split search of a node over its sampled features.
+struct SplitSearch {
+  const vector<uint>* sample_features;
+  NodeHistograms* histograms;
+  GradientData total;
+};
 
+// Picks the best of the splits of the sampled features.
+pair<Split, const Column*> PickBestFeatureAndSplit(const vector<const Column*>& features,
+                                                   const vector<uint>& sample_features,
+                                                   vector<Split>* feature_splits) {
+  auto& splits = *feature_splits;
   uint best_index = 0;
   for (uint i = 1; i < sample_features.size(); ++i) {
     if (splits[i].gain() > splits[best_index].gain()) {
@@ -114,68 +470,274 @@ pair<Split, const Column*> FindBestFeatureAndSplit(const vector<const Column*>&
   return make_pair(Split(), nullptr);
 }
 
-TreeNode FitTreeToGradients(FloatVector w,
-                            const vector<GradientData>& gradient_data_vec,
-                            const vector<const Column*>& features,
-                            const Config& config) {
+// Finds the best split among the sampled features of each node from their
+// histograms. The features of all the nodes are searched in one batch, so that
+// the pool isn't drained between the nodes. The searches are scheduled by the
+// number of buckets of their histograms, largest first, so that a large feature
+// doesn't start last and keep the other threads waiting.
+vector<pair<Split, const Column*>> FindBestFeatureAndSplits(
+    const vector<const Column*>& features, const vector<SplitSearch>& searches,
+    const Config& config) {
+  vector<vector<Split>> splits(searches.size());
+  // Node and feature position of the tasks, with their costs.
+  vector<tuple<int, int, int>> tasks;
+  for (int node = 0; node < searches.size(); ++node) {
+    const auto& sample_features = *searches[node].sample_features;
+    splits[node].resize(sample_features.size());
+    for (int i = 0; i < sample_features.size(); ++i) {
+      const auto* histogram = (*searches[node].histograms)[sample_features[i]].get();
+      if (histogram) {
+        tasks.emplace_back(histogram->size(), node, i);
+      }
+    }
+  }
+  sort(tasks.begin(), tasks.end(), greater<tuple<int, int, int>>());
+
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(tasks.size(), [&](int k) {
+      int node = get<1>(tasks[k]);
+      int i = get<2>(tasks[k]);
+      const auto& search = searches[node];
+      uint feature_index = (*search.sample_features)[i];
+      FindBestSplit(features[feature_index], (*search.histograms)[feature_index].get(), config,
+                    search.total, &splits[node][i]);
+    });
+
+  vector<pair<Split, const Column*>> best_splits;
+  for (int node = 0; node < searches.size(); ++node) {
+    best_splits.push_back(
+        PickBestFeatureAndSplit(features, *searches[node].sample_features, &splits[node]));
+  }
+  return best_splits;
+}
+
+// Splits the nodes and scores their children. If search_children, the best
+// splits of the children are found as well. The work is batched over the nodes:
+// the nodes are partitioned in parallel, the histograms of the smaller children
+// take one pass per block of the bin matrix, those of the larger children are
+// derived by subtraction, and the splits of all the children are searched
+// together. Returns the children, left then right, in the order of the nodes.
+template <typename GRADIENT>
+vector<NodeData<GRADIENT>> ExpandNodes(const vector<NodeData<GRADIENT>>& nodes,
+                                       bool search_children,
+                                       const vector<const Column*>& features,
+                                       const Config& config,
+                                       const GradientData& scale,
+                                       const BinMatrix* bin_matrix,
+                                       HistogramCache* histogram_cache) {
+  const int n = nodes.size();
   double lambda = config.l2_lambda();
-  auto cmp = [] (const NodeData& x, const NodeData& y) {
-      return x.node->split().gain() < y.node->split().gain();
-  };
-  priority_queue<NodeData, vector<NodeData>, decltype(cmp)> node_queue(cmp);
-  TreeNode tree;
 
-  // Subsampling.
-  auto subsamples = Subsampling::UniformSubsample(
-      gradient_data_vec.size(), config.example_sampling_rate());
-  GradientData total = ComputeWeightedSum(w, gradient_data_vec, subsamples);
+  // Partition, which also sums up the gradients of the children.
+  vector<pair<VectorSlice<uint>, VectorSlice<uint>>> sub_slices;
+  for (const auto& node_data : nodes) {
+    sub_slices.emplace_back(node_data.subsamples, node_data.subsamples);
+  }
+  vector<pair<GradientData, GradientData>> sums(n);
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(n, [&](int j) {
+      const auto& node_data = nodes[j];
+      sub_slices[j] = Partition(node_data.feature, node_data.node->split(),
+                                node_data.subsamples, node_data.gradients, node_data.sum,
+                                &sums[j]);
+    });
 
-  tree.set_score(total.Score(lambda));
-  auto root_split = FindBestFeatureAndSplit(
-      features, w, gradient_data_vec, subsamples, total, config);
-  if (root_split.first.gain() > 0) {
-    *(tree.mutable_split()) = std::move(root_split.first);
+  vector<NodeData<GRADIENT>> children;
+  vector<GradientData> child_totals;
+  vector<vector<uint>> child_features(2 * n);
+  vector<NodeHistograms> child_histograms(2 * n);
+  vector<NodeHistograms> parent_histograms(n);
+  vector<vector<uint>> small_features(n);
+  vector<HistogramJob<GRADIENT>> small_jobs;
+  vector<HistogramJob<GRADIENT>> large_jobs;
+  for (int j = 0; j < n; ++j) {
+    auto* node = nodes[j].node;
+    auto gradients_slice = nodes[j].gradients;
+    int left_size = sub_slices[j].first.size();
+    children.emplace_back(node->mutable_left_child(), nullptr, sub_slices[j].first,
+                          VectorSlice<GRADIENT>(gradients_slice, 0, left_size), sums[j].first);
+    children.emplace_back(node->mutable_right_child(), nullptr, sub_slices[j].second,
+                          VectorSlice<GRADIENT>(gradients_slice, left_size,
+                                                gradients_slice.size() - left_size),
+                          sums[j].second);
+    for (int c = 2 * j; c < 2 * j + 2; ++c) {
+      child_totals.push_back(Rescale(children[c].sum, scale));
+      children[c].node->set_score(child_totals[c].Score(lambda));
+      // The features are sampled even if the children aren't searched, so that the
+      // random sequence, and thus the trees, don't change.
+      child_features[c] = Subsampling::UniformSubsample(
+          features.size(), config.feature_sampling_rate());
+    }
+    parent_histograms[j] = histogram_cache->Release(node);
+    if (!search_children) continue;
+
+    // Builds the histograms of the smaller child from its samples, and derives the
+    // histograms of the larger child by subtracting them from the parent's. The
+    // smaller child also covers the features only sampled by the larger child.
+    int small = sub_slices[j].first.size() <= sub_slices[j].second.size() ? 2 * j : 2 * j + 1;
+    int large = small ^ 1;
+    small_features[j] = child_features[small];
+    for (auto i : child_features[large]) {
+      if (HasHistogram(&parent_histograms[j], i)) {
+        small_features[j].push_back(i);
+      }
+    }
+    sort(small_features[j].begin(), small_features[j].end());
+    small_features[j].erase(unique(small_features[j].begin(), small_features[j].end()),
+                            small_features[j].end());
+    small_jobs.push_back(HistogramJob<GRADIENT>{
+        &small_features[j], children[small].subsamples, children[small].gradients,
+        child_totals[small], nullptr, nullptr, &child_histograms[small]});
+    large_jobs.push_back(HistogramJob<GRADIENT>{
+        &child_features[large], children[large].subsamples, children[large].gradients,
+        child_totals[large], &parent_histograms[j], &child_histograms[small],
+        &child_histograms[large]});
   }
-  node_queue.push(NodeData({&tree, root_split.second, VectorSlice<uint>(subsamples)}));
+  if (!search_children) return children;
+
+  ComputeHistograms(features, small_jobs, scale, bin_matrix);
+  ComputeHistograms(features, large_jobs, scale, bin_matrix);
+  parent_histograms.clear();
+
+  vector<SplitSearch> searches;
+  for (int c = 0; c < 2 * n; ++c) {
+    searches.push_back(SplitSearch{&child_features[c], &child_histograms[c], child_totals[c]});
+  }
+  auto child_splits = FindBestFeatureAndSplits(features, searches, config);
+  for (int c = 0; c < 2 * n; ++c) {
+    if (child_splits[c].first.gain() > 0) {
+      *children[c].node->mutable_split() = std::move(child_splits[c].first);
+      children[c].feature = child_splits[c].second;
+      histogram_cache->Add(children[c].node, std::move(child_histograms[c]));
+    }
+  }
+  return children;
+}
+
+// Grows the tree best-first: the leaf with the largest gain is split next.
+template <typename GRADIENT>
+void GrowTreeBestFirst(const NodeData<GRADIENT>& root,
+                       const vector<const Column*>& features,
+                       const Config& config,
+                       const GradientData& scale,
+                       const BinMatrix* bin_matrix,
+                       HistogramCache* histogram_cache) {
+  auto cmp = [] (const NodeData<GRADIENT>& x, const NodeData<GRADIENT>& y) {
+      return x.node->split().gain() < y.node->split().gain();
+  };
+  priority_queue<NodeData<GRADIENT>, vector<NodeData<GRADIENT>>, decltype(cmp)> node_queue(cmp);
+  node_queue.push(root);
 
   // The size of queue is equal to the number of leaves
   while (!node_queue.empty() && node_queue.size() < config.num_leaves() &&
          node_queue.top().feature) {
     auto node_data = node_queue.top();
-    auto* node = node_data.node;
-    const auto* feature = node_data.feature;
-    auto subsamples_slice = node_data.subsamples;
+    node_queue.pop();
+    // The split adds one leaf. If that makes num_leaves leaves, the children are
+    // never expanded, so their histograms and splits are not computed.
+    bool search_children = node_queue.size() + 2 < config.num_leaves();
+    vector<NodeData<GRADIENT>> nodes = {node_data};
+    for (const auto& child : ExpandNodes(nodes, search_children, features, config, scale,
+                                         bin_matrix, histogram_cache)) {
+      node_queue.push(child);
+    }
+  }
+}
 
-    // Partition.
-    auto sub_slices = Partition(feature, node->split(), subsamples_slice);
+// Grows the tree depth-wise: all the leaves of a level that have a split are
+// expanded together, those with the largest gains first if num_leaves doesn't
+// allow all of them.
+template <typename GRADIENT>
+void GrowTreeDepthWise(const NodeData<GRADIENT>& root,
+                       const vector<const Column*>& features,
+                       const Config& config,
+                       const GradientData& scale,
+                       const BinMatrix* bin_matrix,
+                       HistogramCache* histogram_cache) {
+  vector<NodeData<GRADIENT>> level = {root};
+  int num_leaves = 1;
+  while (num_leaves < config.num_leaves()) {
+    vector<NodeData<GRADIENT>> nodes;
+    for (const auto& node_data : level) {
+      if (node_data.feature) nodes.push_back(node_data);
+    }
+    stable_sort(nodes.begin(), nodes.end(),
+                [] (const NodeData<GRADIENT>& x, const NodeData<GRADIENT>& y) {
+                  return x.node->split().gain() > y.node->split().gain();
+                });
+    int num_expanded = min<int>(nodes.size(), config.num_leaves() - num_leaves);
+    for (int j = num_expanded; j < nodes.size(); ++j) {
+      histogram_cache->Release(nodes[j].node);
+    }
+    nodes.erase(nodes.begin() + num_expanded, nodes.end());
+    if (nodes.empty()) break;
 
-    GradientData left_total = ComputeWeightedSum(w, gradient_data_vec, sub_slices.first);
-    GradientData right_total = ComputeWeightedSum(w, gradient_data_vec, sub_slices.second);
+    num_leaves += num_expanded;
+    level = ExpandNodes(nodes, num_leaves < config.num_leaves(), features, config, scale,
+                        bin_matrix, histogram_cache);
+  }
+}
 
-    // Left.
-    auto* left_child = node->mutable_left_child();
-    left_child->set_score(left_total.Score(lambda));
-    auto left_split = FindBestFeatureAndSplit(
-        features, w, gradient_data_vec, sub_slices.first, left_total, config);
-    if (left_split.first.gain() > 0) {
-      *left_child->mutable_split() = std::move(left_split.first);
-    }
+// Grows the tree with the ordered gradients stored as GRADIENT.
+template <typename GRADIENT>
+TreeNode FitTreeWithOrderedGradients(FloatVector w,
+                                     const vector<GradientData>& gradient_data_vec,
+                                     const vector<const Column*>& features,
+                                     const Config& config,
+                                     const BinMatrix* bin_matrix) {
+  double lambda = config.l2_lambda();
+  TreeNode tree;
+  HistogramCache histogram_cache(static_cast<size_t>(FLAGS_histogram_cache_mb) << 20);
 
-    // Right.
-    auto* right_child = node->mutable_right_child();
-    right_child->set_score(right_total.Score(lambda));
-    auto right_split = FindBestFeatureAndSplit(
-        features, w, gradient_data_vec, sub_slices.second, right_total, config);
-    if (right_split.first.gain() > 0) {
-      *right_child->mutable_split() = std::move(right_split.first);
-    }
+  // Subsampling.
+  auto subsamples = SubsampleRows(gradient_data_vec, config, &w);
+  vector<GRADIENT> ordered_gradients;
+  GradientData scale;
+  MakeOrderedGradients(w, gradient_data_vec, subsamples, config, &ordered_gradients, &scale);
+  VectorSlice<GRADIENT> root_gradients(ordered_gradients);
+  GradientData root_sum = ComputeWeightedSum(root_gradients);
+  GradientData total = Rescale(root_sum, scale);
 
-    node_queue.pop();
-    node_queue.push(NodeData(left_child, left_split.second, sub_slices.first));
-    node_queue.push(NodeData(right_child, right_split.second, sub_slices.second));
+  tree.set_score(total.Score(lambda));
+  auto root_features = Subsampling::UniformSubsample(
+      features.size(), config.feature_sampling_rate());
+  NodeHistograms root_histograms;
+  vector<HistogramJob<GRADIENT>> root_jobs = {HistogramJob<GRADIENT>{
+      &root_features, VectorSlice<uint>(subsamples), root_gradients, total, nullptr, nullptr,
+      &root_histograms}};
+  ComputeHistograms(features, root_jobs, scale, bin_matrix);
+  auto root_split = std::move(FindBestFeatureAndSplits(
+      features, {SplitSearch{&root_features, &root_histograms, total}}, config)[0]);
+  if (root_split.first.gain() > 0) {
+    *(tree.mutable_split()) = std::move(root_split.first);
+    histogram_cache.Add(&tree, std::move(root_histograms));
   }
+  NodeData<GRADIENT> root(&tree, root_split.second, VectorSlice<uint>(subsamples),
+                          root_gradients, root_sum);
 
+  if (config.growth_policy() == "depth_wise") {
+    GrowTreeDepthWise(root, features, config, scale, bin_matrix, &histogram_cache);
+  } else {
+    GrowTreeBestFirst(root, features, config, scale, bin_matrix, &histogram_cache);
+  }
   return tree;
 }
 
+TreeNode FitTreeToGradients(FloatVector w,
+                            const vector<GradientData>& gradient_data_vec,
+                            const vector<const Column*>& features,
+                            const Config& config,
+                            const BinMatrix* bin_matrix) {
+  if (config.gradient_quantization_bits() == 8) {
+    return FitTreeWithOrderedGradients<QuantizedGradientData<int8>>(
+        w, gradient_data_vec, features, config, bin_matrix);
+  } else if (config.gradient_quantization_bits() == 16) {
+    return FitTreeWithOrderedGradients<QuantizedGradientData<int16>>(
+        w, gradient_data_vec, features, config, bin_matrix);
+  } else if (FLAGS_compact_gradients) {
+    return FitTreeWithOrderedGradients<CompactGradientData>(
+        w, gradient_data_vec, features, config, bin_matrix);
+  }
+  return FitTreeWithOrderedGradients<GradientData>(
+      w, gradient_data_vec, features, config, bin_matrix);
+}
+
 }  // namespace gbdt
@@ -23,6 +23,7 @@
 
 namespace gbdt {
 
+class BinMatrix;
 class Column;
 struct GradientData;
 class SamplingConfig;
@@ -30,11 +31,15 @@ class Config;
 class TreeNode;
 
 // Given gradients and weights, fit trees to minimize mse.
-// It subsamples the examples and features according to the sampling_config.
+// It subsamples the examples, uniformly or with GOSS, and the features according to
+// the config.
+// If bin_matrix is given, the histograms of the bundled features are computed
+// from it.
 TreeNode FitTreeToGradients(FloatVector w,
                             const vector<GradientData>& gradient_data_vec,
                             const vector<const Column*>& features,
-                            const Config& config);
+                            const Config& config,
+                            const BinMatrix* bin_matrix = nullptr);
 
 }  // namespace gbdt
 
@@ -18,15 +18,19 @@
 
 #include "tree_algo.h"
 
+#include <gflags/gflags.h>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "bin_matrix.h"
 #include "src/data_store/column.h"
 #include "src/proto/config.pb.h"
 #include "src/proto/tree.pb.h"
 #include "src/loss_func/gradient_data.h"
 #include "src/utils/subsampling.h"
 
+DECLARE_bool(compact_gradients);
+
 namespace gbdt {
 
 class TreeBuildingTest : public testing::Test {
@@ -84,7 +88,7 @@ class TreeBuildingTest : public testing::Test {
     {2.0, 1.0}, {2.0, 1.0}, {2.0, 1.0}, {2.0, 1.0},
     {3.0, 1.0}, {3.0, 1.0}, {3.0, 1.0}, {3.0, 1.0},
     {4.0, 1.0}, {4.0, 1.0}, {4.0, 1.0}, {4.0, 1.0}};
-  FloatVector w_ = [] (int) { return 1.0; };
+  FloatVector w_;
 
   vector<uint> allsamples_;
 };
@@ -119,6 +123,7 @@ TEST_F(TreeBuildingTest, BuildTree) {
       "    feature: \"feature5\"\n"
       "    float_split {\n"
       "      threshold: 1.5\n"
+      "      internal_bucket_threshold: 2\n"
       "    }\n"
       "  }\n"
       "  left_child {\n"
@@ -128,6 +133,7 @@ TEST_F(TreeBuildingTest, BuildTree) {
       "      float_split {\n"
       "        threshold: 1.5\n"
       "        missing_to_right_child: true\n"
+      "        internal_bucket_threshold: 2\n"
       "      }\n"
       "    }\n"
       "    left_child {\n"
@@ -136,6 +142,7 @@ TEST_F(TreeBuildingTest, BuildTree) {
       "        feature: \"feature3\"\n"
       "        float_split {\n"
       "          threshold: 0.5\n"
+      "          internal_bucket_threshold: 2\n"
       "        }\n"
       "      }\n"
       "      left_child {\n"
@@ -168,4 +175,116 @@ TEST_F(TreeBuildingTest, BuildTreeWithIrrlevantFeatures) {
   EXPECT_EQ(2.5, t.score());
 }
 
+TEST_F(TreeBuildingTest, BuildTreeWithFewLeaves) {
+  vector<const Column*> features = { parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  config_.set_num_leaves(3);
+  TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  RemoveGains(&t);
+  // The children of the last split are never expanded, so no split is searched
+  // for them.
+  EXPECT_EQ("feature4", t.split().feature());
+  EXPECT_FALSE(t.left_child().has_split());
+  EXPECT_EQ("feature5", t.right_child().split().feature());
+  EXPECT_FLOAT_EQ(2.8, t.right_child().left_child().score());
+  EXPECT_FALSE(t.right_child().left_child().has_split());
+  EXPECT_FALSE(t.right_child().right_child().has_split());
+}
+
+TEST_F(TreeBuildingTest, BuildTreeDepthWise) {
+  vector<const Column*> features = { const_float_feature_.get(),
+                                     const_string_feature_.get(),
+                                     irrelevant_feature_.get(),
+                                     parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  BinMatrix bin_matrix(features, 1 << 20, 2);
+  // Every node with a split is on a different level, so both policies grow the
+  // same trees.
+  for (int num_leaves : {3, 10}) {
+    config_.set_num_leaves(num_leaves);
+    TreeNode expected = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+    Config config = config_;
+    config.set_growth_policy("depth_wise");
+    TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config);
+    EXPECT_EQ(expected.DebugString(), t.DebugString());
+    t = FitTreeToGradients(w_, gradient_data_vec_, features, config, &bin_matrix);
+    EXPECT_EQ(expected.DebugString(), t.DebugString());
+  }
+}
+
+TEST_F(TreeBuildingTest, BuildTreeWithGoss) {
+  vector<const Column*> features = { parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  TreeNode expected = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  // All the other rows are sampled with a unit amplification.
+  Config config = config_;
+  config.set_goss_top_rate(0.5);
+  config.set_goss_other_rate(0.5);
+  TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config);
+  EXPECT_EQ(expected.DebugString(), t.DebugString());
+
+  // Only the rows with the largest gradients are sampled.
+  config.set_goss_other_rate(0);
+  t = FitTreeToGradients(w_, gradient_data_vec_, features, config);
+  EXPECT_TRUE(t.has_split());
+}
+
+TEST_F(TreeBuildingTest, BuildTreeWithBinMatrix) {
+  vector<const Column*> features = { const_float_feature_.get(),
+                                     const_string_feature_.get(),
+                                     irrelevant_feature_.get(),
+                                     parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  // Two blocks of several features each.
+  BinMatrix bin_matrix(features, 1 << 20, 2);
+  TreeNode expected = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config_, &bin_matrix);
+  EXPECT_EQ(expected.DebugString(), t.DebugString());
+}
+
+TEST_F(TreeBuildingTest, BuildTreeWithCompactGradients) {
+  vector<const Column*> features = { const_float_feature_.get(),
+                                     const_string_feature_.get(),
+                                     irrelevant_feature_.get(),
+                                     parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  TreeNode expected = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  FLAGS_compact_gradients = true;
+  TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  FLAGS_compact_gradients = false;
+  // The gradients are exact in single precision.
+  EXPECT_EQ(expected.DebugString(), t.DebugString());
+}
+
+TEST_F(TreeBuildingTest, BuildTreeWithQuantizedGradients) {
+  vector<const Column*> features = { const_float_feature_.get(),
+                                     const_string_feature_.get(),
+                                     irrelevant_feature_.get(),
+                                     parity_feature_.get(),
+                                     zero_feature_.get(),
+                                     three_feature0_.get(),
+                                     three_feature1_.get() };
+  TreeNode expected = FitTreeToGradients(w_, gradient_data_vec_, features, config_);
+  for (int bits : {8, 16}) {
+    Config config = config_;
+    config.set_gradient_quantization_bits(bits);
+    TreeNode t = FitTreeToGradients(w_, gradient_data_vec_, features, config);
+    // Quantization only rounds the scores.
+    EXPECT_EQ(expected.split().feature(), t.split().feature());
+    EXPECT_EQ(expected.left_child().split().feature(), t.left_child().split().feature());
+    EXPECT_EQ(expected.right_child().split().feature(), t.right_child().split().feature());
+    EXPECT_NEAR(expected.score(), t.score(), 1e-2);
+  }
+}
+
 }  // namespace gbdt
@@ -16,6 +16,7 @@
 
 #include "utils.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <string>
 #include <unordered_set>
@@ -46,9 +47,9 @@ Status LoadFeatures(const unordered_set<string>& feature_names,
   stopwatch.Start();
 
   {
-    ThreadPool pool(FLAGS_num_threads);
+    TaskGroup group(ThreadPool::Get(FLAGS_num_threads));
     for (const auto& feature_name : feature_names) {
-      pool.Enqueue([&]() { data_store->GetColumn(feature_name); });
+      group.Run([&]() { data_store->GetColumn(feature_name); });
     }
   }
 
@@ -159,12 +160,11 @@ FloatVector GetSampleWeightsOrDie(const Config& config, DataStore* data_store) {
   if (!weight_column_name.empty()) {
     const auto* sample_weights = data_store->GetRawFloatColumn(weight_column_name);
     CHECK(sample_weights) << "Failed to load sample weights";
-    return [weights=sample_weights](int i) {
-      return (*weights)[i];
-    };
+    return FloatVector(sample_weights->raw_floats());
   }
 
-  return [](int) { return 1.0; };
+  // Unit weights.
+  return FloatVector();
 }
 
 FloatVector GetTargetsOrDie(const Config& config, DataStore* data_store) {
@@ -176,9 +176,12 @@ FloatVector GetTargetsOrDie(const Config& config, DataStore* data_store) {
   const auto& raw_floats = targets->raw_floats();
 
   if (config.binarize_target()) {
-    return [&raw_floats](int i) { return raw_floats[i] > 0 ? 1 : -1; };
+    vector<float> binarized_targets(raw_floats.size());
+    std::transform(raw_floats.begin(), raw_floats.end(), binarized_targets.begin(),
+                   [](float target) { return target > 0 ? 1.0f : -1.0f; });
+    return FloatVector(std::move(binarized_targets));
   } else {
-    return [&raw_floats](int i) { return raw_floats[i]; };
+    return FloatVector(raw_floats);
   }
 }
 
@@ -224,6 +227,30 @@ Status CheckConfig(Config config) {
                   fmt::format("feature_sampling_rate should be in [0, 1] (actual {0})",
                               config.feature_sampling_rate()));
   }
+  if (config.goss_top_rate() < 0 || config.goss_top_rate() > 1) {
+    return Status(error::INVALID_ARGUMENT,
+                  fmt::format("goss_top_rate should be in [0, 1] (actual {0})",
+                              config.goss_top_rate()));
+  }
+  if (config.goss_top_rate() > 0 &&
+      (config.goss_other_rate() < 0 ||
+       config.goss_top_rate() + config.goss_other_rate() > 1)) {
+    return Status(error::INVALID_ARGUMENT,
+                  fmt::format("goss_other_rate should be in [0, 1 - goss_top_rate] (actual {0})",
+                              config.goss_other_rate()));
+  }
+  if (config.gradient_quantization_bits() != 0 && config.gradient_quantization_bits() != 8 &&
+      config.gradient_quantization_bits() != 16) {
+    return Status(error::INVALID_ARGUMENT,
+                  fmt::format("gradient_quantization_bits should be 0, 8 or 16 (actual {0})",
+                              config.gradient_quantization_bits()));
+  }
+  if (!config.growth_policy().empty() && config.growth_policy() != "best_first" &&
+      config.growth_policy() != "depth_wise") {
+    return Status(error::INVALID_ARGUMENT,
+                  fmt::format("growth_policy should be best_first or depth_wise (actual {0})",
+                              config.growth_policy()));
+  }
   return Status::OK;
 }
 
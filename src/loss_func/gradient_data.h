@@ -61,6 +61,35 @@ inline GradientData operator * (float w, const GradientData& data) {
   return GradientData(w * data.g, w * data.h);
 }
 
+// CompactGradientData stores g and h in single precision, which halves the memory
+// read per sample when gradients are scanned repeatedly. It is only a storage
+// format: sums are always accumulated in GradientData.
+struct CompactGradientData {
+  CompactGradientData() {}
+  explicit CompactGradientData(const GradientData& data) : g(data.g), h(data.h) {}
+  inline operator GradientData() const {
+    return GradientData(g, h);
+  }
+
+  float g = 0.0f;
+  float h = 0.0f;
+};
+
+// QuantizedGradientData stores g and h as integers of type INT (int8 or int16) in
+// units of a scale chosen per tree, i.e. the gradients are g * scale.g and
+// h * scale.h. Sums of quantized gradients are exact, so they don't depend on the
+// order of the additions.
+template <typename INT>
+struct QuantizedGradientData {
+  // Returns g and h in units of the scale.
+  inline operator GradientData() const {
+    return GradientData(g, h);
+  }
+
+  INT g = 0;
+  INT h = 0;
+};
+
 // Contains GradientData and the loss.
 struct LossFuncData {
   LossFuncData() {}
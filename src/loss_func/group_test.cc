@@ -16,6 +16,7 @@
 #include "group.h"
 
 #include <memory>
+#include <numeric>
 #include <random>
 
 #include "gtest/gtest.h"
@@ -33,7 +34,7 @@ class GroupTest : public ::testing::Test {
 };
 
 TEST_F(GroupTest, TestGroup) {
-  Group group({0, 2, 3, 4, 5, 7, 9, 10}, [this](int i) { return targets_[i]; });
+  Group group({0, 2, 3, 4, 5, 7, 9, 10}, FloatVector(targets_));
   vector<float> targets(group.size());
   for (int i = 0; i < targets.size(); ++i) {
     targets[i] = targets_[group[i]];
@@ -64,7 +65,9 @@ TEST_F(GroupTest, TestGroup) {
 }
 
 TEST_F(GroupTest, TestRerank) {
-  Group group({0, 2, 3, 4, 5, 7, 9, 10}, [this](int i) { return i; });
+  vector<float> indices(targets_.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  Group group({0, 2, 3, 4, 5, 7, 9, 10}, FloatVector(indices));
 
   vector<double> f(targets_.size());
   // f is the reverse rank of targets.
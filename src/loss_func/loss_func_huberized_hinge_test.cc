@@ -35,8 +35,8 @@ class HuberizedHingeTest : public ::testing::Test {
   }
 
   unique_ptr<HuberizedHinge> hinge_;
-  FloatVector w_ = [](int i) { return i < 4 ? 1.0 : 2.0; };
-  FloatVector y_ = [](int i) { return i < 4 ? -1 : 1.0; };
+  FloatVector w_ = vector<float>{1, 1, 1, 1, 2, 2, 2, 2};
+  FloatVector y_ = vector<float>{-1, -1, -1, -1, 1, 1, 1, 1};
   int num_rows_ = 8;
 };
 
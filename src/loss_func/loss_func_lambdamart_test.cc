@@ -47,8 +47,8 @@ class PairwiseTest : public ::testing::Test {
   DataStore data_store_;
   const int kSamplingRate_ = 100000;
   Config config_;
-  FloatVector w_ = [](int) { return 1.0; };
-  FloatVector y_ = [](int i) { return i; };
+  FloatVector w_;
+  FloatVector y_ = vector<float>{0, 1, 2, 3};
 };
 
 TEST_F(PairwiseTest, TestComputeFunctionalGradientsAndHessians) {
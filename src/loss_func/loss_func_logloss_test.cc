@@ -34,8 +34,8 @@ class LossFuncLogLossTest : public ::testing::Test {
   }
 
   unique_ptr<LogLoss> logloss_;
-  FloatVector w_ = [](int i) { return i < 4 ? 1.0 : 2.0; };
-  FloatVector y_ = [](int i) { return i < 4 ? -1.0 : 1.0; };
+  FloatVector w_ = vector<float>{1, 1, 1, 1, 2, 2, 2, 2};
+  FloatVector y_ = vector<float>{-1, -1, -1, -1, 1, 1, 1, 1};
   int num_rows_ = 8;
 };
 
@@ -34,8 +34,8 @@ class LossFuncMSETest : public ::testing::Test {
   }
   
   unique_ptr<MSE> mse_;
-  FloatVector w_ = [](int) { return 1.0; };
-  FloatVector y_ = [](int i) { return i < 4 ? 0 : 1.0; };
+  FloatVector w_;
+  FloatVector y_ = vector<float>{0, 0, 0, 0, 1, 1, 1, 1};
   int num_rows_ = 8;
 };
 
@@ -110,45 +110,43 @@ void Pairwise::ComputeFunctionalGradientsAndHessians(const vector<double>& f,
   // Sample pairs and compute pairwise loss.
   vector<double> losses(slices_.size(), 0.0);
   vector<double> weight_sums(slices_.size(), 0.0);
-  {
-    ThreadPool pool(FLAGS_num_threads);
-    for (int j = 0; j < slices_.size(); ++j) {
-      pool.Enqueue([&, this, &slice=slices_[j], &loss=losses[j], &weight_sum=weight_sums[j]]() {
-          std::mt19937* generator = Subsampling::get_generator();
-          for (int group_index = slice.first; group_index < slice.second; ++group_index) {
-            auto& group = groups_[group_index];
-            if (rerank_) group.Rerank(f);
-
-            uint64 num_sample_pairs = group.num_pairs() * pair_sampling_probability_;
-
-            // To make each group's weight constant, we rescale each group's weight by
-            // 1.0 / group.num_pairs().
-            double weight_rescaling_factor = equal_group_weight_ ?
-                                             double(min_num_pairs_) / group.num_pairs() : 1.0;
-            auto pair_weighting_func = PairWeightingFunc(group);
-            for (int i = 0; i < num_sample_pairs; ++i) {
-              auto p = group.SamplePair(generator);
-              auto pos_sample = group[p.first];
-              auto neg_sample = group[p.second];
-              double weight = w_(pos_sample) * w_(neg_sample) * pair_weighting_func(p) *
-                              weight_rescaling_factor;
-              double delta_target = y_(pos_sample) - y_(neg_sample);
-              double delta_func = f[pos_sample] - f[neg_sample];
-
-              auto data = loss_func_(delta_target, delta_func);
-              auto& pos_gradient_data = (*gradient_data_vec)[pos_sample];
-              auto& neg_gradient_data = (*gradient_data_vec)[neg_sample];
-              pos_gradient_data.g += weight * std::get<1>(data);
-              neg_gradient_data.g -= weight * std::get<1>(data);
-              pos_gradient_data.h += 2.0 * weight * std::get<2>(data);
-              neg_gradient_data.h += 2.0 * weight * std::get<2>(data);
-              loss += weight * std::get<0>(data);
-              weight_sum += weight;
-            }
-          }
-        });
-    }
-  }
+  ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices_.size(), [&](int j) {
+      const auto& slice = slices_[j];
+      auto& loss = losses[j];
+      auto& weight_sum = weight_sums[j];
+      std::mt19937* generator = Subsampling::get_generator();
+      for (int group_index = slice.first; group_index < slice.second; ++group_index) {
+        auto& group = groups_[group_index];
+        if (rerank_) group.Rerank(f);
+
+        uint64 num_sample_pairs = group.num_pairs() * pair_sampling_probability_;
+
+        // To make each group's weight constant, we rescale each group's weight by
+        // 1.0 / group.num_pairs().
+        double weight_rescaling_factor = equal_group_weight_ ?
+                                         double(min_num_pairs_) / group.num_pairs() : 1.0;
+        auto pair_weighting_func = PairWeightingFunc(group);
+        for (int i = 0; i < num_sample_pairs; ++i) {
+          auto p = group.SamplePair(generator);
+          auto pos_sample = group[p.first];
+          auto neg_sample = group[p.second];
+          double weight = w_(pos_sample) * w_(neg_sample) * pair_weighting_func(p) *
+                          weight_rescaling_factor;
+          double delta_target = y_(pos_sample) - y_(neg_sample);
+          double delta_func = f[pos_sample] - f[neg_sample];
+
+          auto data = loss_func_(delta_target, delta_func);
+          auto& pos_gradient_data = (*gradient_data_vec)[pos_sample];
+          auto& neg_gradient_data = (*gradient_data_vec)[neg_sample];
+          pos_gradient_data.g += weight * std::get<1>(data);
+          neg_gradient_data.g -= weight * std::get<1>(data);
+          pos_gradient_data.h += 2.0 * weight * std::get<2>(data);
+          neg_gradient_data.h += 2.0 * weight * std::get<2>(data);
+          loss += weight * std::get<0>(data);
+          weight_sum += weight;
+        }
+      }
+    });
 
   double loss = std::accumulate(losses.begin(), losses.end(), 0.0);
   double weight_sum = std::accumulate(weight_sums.begin(), weight_sums.end(), 0.0);
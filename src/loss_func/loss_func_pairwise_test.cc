@@ -56,8 +56,8 @@ class PairwiseTest : public ::testing::Test {
   }
 
   DataStore data_store_;
-  FloatVector w_ = [](int) { return 1.0; };
-  FloatVector y_ = [](int i) { return i; };
+  FloatVector w_;
+  FloatVector y_ = vector<float>{0, 1, 2, 3};
   vector<double> f_ = { 0, 0, 0, 0};
   // Set sampleing_rate to 10000 so that g and h are more stable.
   const int kSamplingRate_ = 100000;
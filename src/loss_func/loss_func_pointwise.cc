@@ -41,8 +41,12 @@ Status Pointwise::Init(int num_rows, FloatVector w, FloatVector y, const StringC
   w_ = w;
   y_ = y;
   weight_sum_ = 0;
-  for (int i = 0; i < num_rows; ++i) {
-    weight_sum_ += w(i);
+  if (w.unit()) {
+    weight_sum_ = num_rows;
+  } else {
+    for (int i = 0; i < num_rows; ++i) {
+      weight_sum_ += w(i);
+    }
   }
   slices_ = Subsampling::DivideSamples(num_rows, FLAGS_num_threads * 5);
   return Status::OK;
@@ -63,23 +67,21 @@ void Pointwise::ComputeFunctionalGradientsAndHessians(const vector<double>& f,
   LossFuncData total;
   do {
     vector<LossFuncData> totals(slices_.size());
-    {
-      ThreadPool pool(FLAGS_num_threads);
-      for (int j = 0; j < slices_.size(); ++j) {
-          pool.Enqueue([&, this, &slice=slices_[j], &total=totals[j]](){
+    ThreadPool::Get(FLAGS_num_threads)->ParallelFor(slices_.size(), [&](int j) {
+        const auto& slice = slices_[j];
+        auto& total = totals[j];
+        w_.Visit([&](auto w) {
             for (int i = slice.first; i < slice.second; ++i) {
               double f_current = f[i] + *c;
               auto data = loss_func_(y_(i), f_current);
-              auto w = w_(i);
               auto& gradient_data = (*gradient_data_vec)[i];
               gradient_data.g = std::get<1>(data);
               gradient_data.h = std::get<2>(data);
-              total.loss += w * std::get<0>(data);
-              total.gradient_data += w * gradient_data;
+              total.loss += w.Apply(i, std::get<0>(data));
+              total.gradient_data += w.Apply(i, gradient_data);
             }
           });
-      }
-    }
+      });
     total = std::accumulate(totals.begin(), totals.end(), LossFuncData());
     delta_c = total.gradient_data.Score(0);
     *c += delta_c;
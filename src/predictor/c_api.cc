@@ -0,0 +1,83 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "c_api.h"
+
+#include <string>
+#include <vector>
+
+#include "predictor.h"
+#include "src/proto/tree.pb.h"
+#include "src/utils/json_utils.h"
+
+struct GbdtPredictor {
+  unique_ptr<gbdt::Predictor> predictor;
+};
+
+namespace {
+
+thread_local string last_error;
+
+vector<string> ToStrings(const char* const* strings, int size) {
+  return vector<string>(strings, strings + size);
+}
+
+}  // namespace
+
+int GbdtPredictorCreate(const char* forest_json,
+                        const char* const* float_features,
+                        int num_float_features,
+                        const char* const* string_features,
+                        int num_string_features,
+                        GbdtPredictor** predictor) {
+  gbdt::Forest forest;
+  auto status = JsonUtils::FromJson(forest_json, &forest);
+  if (status.ok()) {
+    unique_ptr<GbdtPredictor> new_predictor(new GbdtPredictor);
+    status = gbdt::Predictor::Create(forest,
+                                     ToStrings(float_features, num_float_features),
+                                     ToStrings(string_features, num_string_features),
+                                     &new_predictor->predictor);
+    if (status.ok()) {
+      *predictor = new_predictor.release();
+      return 0;
+    }
+  }
+  last_error = status.ToString();
+  return -1;
+}
+
+void GbdtPredictorFree(GbdtPredictor* predictor) {
+  delete predictor;
+}
+
+double GbdtPredictorPredict(const GbdtPredictor* predictor,
+                            const float* float_values,
+                            const char* const* string_values) {
+  return predictor->predictor->Predict(float_values, string_values);
+}
+
+void GbdtPredictorPredictBatch(const GbdtPredictor* predictor,
+                               int num_rows,
+                               const float* float_values,
+                               const char* const* string_values,
+                               double* scores) {
+  predictor->predictor->PredictBatch(num_rows, float_values, string_values, scores);
+}
+
+const char* GbdtGetLastError() {
+  return last_error.c_str();
+}
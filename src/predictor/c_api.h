@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_API_H_
+#define C_API_H_
+
+// C interface of Predictor for embedding the scoring in other languages and
+// serving layers. See predictor.h for the layout of the rows and the semantics
+// of the splits.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GbdtPredictor GbdtPredictor;
+
+// Creates a predictor from a forest in JSON and the names of the float and the
+// string features of the rows. Returns 0 on success, or -1 with the error in
+// GbdtGetLastError().
+int GbdtPredictorCreate(const char* forest_json,
+                        const char* const* float_features,
+                        int num_float_features,
+                        const char* const* string_features,
+                        int num_string_features,
+                        GbdtPredictor** predictor);
+
+void GbdtPredictorFree(GbdtPredictor* predictor);
+
+// Returns the score of a row. NAN marks a missing float value and NULL a missing
+// string value.
+double GbdtPredictorPredict(const GbdtPredictor* predictor,
+                            const float* float_values,
+                            const char* const* string_values);
+
+// Scores num_rows rows stored row by row into scores.
+void GbdtPredictorPredictBatch(const GbdtPredictor* predictor,
+                               int num_rows,
+                               const float* float_values,
+                               const char* const* string_values,
+                               double* scores);
+
+// Returns the error of the last failed call on the calling thread.
+const char* GbdtGetLastError();
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // C_API_H_
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "c_api.h"
+
+#include <cmath>
+#include <string>
+#include <google/protobuf/text_format.h>
+
+#include "gtest/gtest.h"
+#include "src/base/base.h"
+#include "src/proto/tree.pb.h"
+#include "src/utils/json_utils.h"
+
+namespace gbdt {
+
+TEST(CApiTest, CreateAndPredict) {
+  Forest forest;
+  string text = "tree {"
+                "  split { feature: 'color' cat_split { category: ['red'] } }"
+                "  left_child { score: 1.0 }"
+                "  right_child {"
+                "    split { feature: 'length' float_split { threshold: 3.0 } }"
+                "    left_child { score: 2.0 }"
+                "    right_child { score: 4.0 }"
+                "  }"
+                "}";
+  CHECK(google::protobuf::TextFormat::ParseFromString(text, &forest));
+  string forest_json;
+  CHECK(JsonUtils::ToJson(forest, &forest_json).ok());
+
+  const char* float_features[] = {"length"};
+  const char* string_features[] = {"color"};
+  GbdtPredictor* predictor = nullptr;
+  ASSERT_EQ(0, GbdtPredictorCreate(forest_json.c_str(), float_features, 1, string_features, 1,
+                                   &predictor));
+
+  float float_values[] = {1, 1, 5};
+  const char* string_values[] = {"red", "blue", nullptr};
+  EXPECT_EQ(1.0, GbdtPredictorPredict(predictor, float_values, string_values));
+  double scores[3];
+  GbdtPredictorPredictBatch(predictor, 3, float_values, string_values, scores);
+  EXPECT_EQ(1.0, scores[0]);
+  EXPECT_EQ(2.0, scores[1]);
+  EXPECT_EQ(4.0, scores[2]);
+  GbdtPredictorFree(predictor);
+
+  // Fails when a feature is missing from the schema.
+  predictor = nullptr;
+  EXPECT_EQ(-1, GbdtPredictorCreate(forest_json.c_str(), float_features, 1, nullptr, 0,
+                                    &predictor));
+  EXPECT_EQ(nullptr, predictor);
+  EXPECT_NE(string::npos, string(GbdtGetLastError()).find("color"));
+}
+
+}  // namespace gbdt
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "predictor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "external/cppformat/format.h"
+
+#include "src/proto/tree.pb.h"
+
+namespace gbdt {
+
+namespace {
+
+unordered_map<string, int> IndexFeatures(const vector<string>& features) {
+  unordered_map<string, int> indices;
+  for (int i = 0; i < features.size(); ++i) {
+    indices[features[i]] = i;
+  }
+  return indices;
+}
+
+}  // namespace
+
+Status Predictor::Create(const Forest& forest,
+                         const vector<string>& float_features,
+                         const vector<string>& string_features,
+                         unique_ptr<Predictor>* predictor) {
+  auto float_indices = IndexFeatures(float_features);
+  auto string_indices = IndexFeatures(string_features);
+  unique_ptr<Predictor> new_predictor(
+      new Predictor(float_features.size(), string_features.size()));
+  for (const auto& tree : forest.tree()) {
+    int root;
+    auto status = new_predictor->CompileNode(tree, float_indices, string_indices, &root);
+    if (!status.ok()) return status;
+    new_predictor->roots_.push_back(root);
+  }
+  *predictor = std::move(new_predictor);
+  return Status::OK;
+}
+
+Status Predictor::CompileNode(const TreeNode& tree_node,
+                              const unordered_map<string, int>& float_indices,
+                              const unordered_map<string, int>& string_indices,
+                              int* index) {
+  if (!tree_node.has_left_child()) {
+    leaf_scores_.push_back(tree_node.score());
+    *index = ~static_cast<int>(leaf_scores_.size() - 1);
+    return Status::OK;
+  }
+
+  const auto& split = tree_node.split();
+  Node node;
+  node.categorical = split.has_cat_split();
+  const auto& indices = node.categorical ? string_indices : float_indices;
+  auto it = indices.find(split.feature());
+  if (it == indices.end()) {
+    return Status(error::NOT_FOUND,
+                  fmt::format("Feature {0} is not a {1} feature of the schema.", split.feature(),
+                              node.categorical ? "string" : "float"));
+  }
+  node.feature = it->second;
+  if (node.categorical) {
+    node.missing_to_left = false;
+    node.threshold = 0;
+    node.categories_begin = categories_.size();
+    categories_.insert(categories_.end(), split.cat_split().category().begin(),
+                       split.cat_split().category().end());
+    node.categories_end = categories_.size();
+    sort(categories_.begin() + node.categories_begin, categories_.end());
+  } else {
+    node.missing_to_left = !split.float_split().missing_to_right_child();
+    node.threshold = split.float_split().threshold();
+    node.categories_begin = node.categories_end = 0;
+  }
+
+  *index = nodes_.size();
+  nodes_.push_back(node);
+  int left_child, right_child;
+  auto status = CompileNode(tree_node.left_child(), float_indices, string_indices, &left_child);
+  if (!status.ok()) return status;
+  status = CompileNode(tree_node.right_child(), float_indices, string_indices, &right_child);
+  if (!status.ok()) return status;
+  nodes_[*index].left_child = left_child;
+  nodes_[*index].right_child = right_child;
+  return Status::OK;
+}
+
+bool Predictor::HasCategory(const Node& node, const char* value) const {
+  auto begin = categories_.begin() + node.categories_begin;
+  auto end = categories_.begin() + node.categories_end;
+  auto it = lower_bound(begin, end, value, [](const string& category, const char* value) {
+      return strcmp(category.c_str(), value) < 0;
+    });
+  return it != end && *it == value;
+}
+
+double Predictor::Predict(const float* float_values, const char* const* string_values) const {
+  double score = 0.0;
+  for (int tree = 0; tree < roots_.size(); ++tree) {
+    score += leaf_scores_[GetLeaf(tree, float_values, string_values)];
+  }
+  return score;
+}
+
+void Predictor::PredictBatch(int num_rows, const float* float_values,
+                             const char* const* string_values, double* scores) const {
+  fill(scores, scores + num_rows, 0.0);
+  // The rows of the batch are taken through one tree at a time, which keeps the
+  // nodes of the tree in cache. The scores are still summed tree by tree.
+  for (int tree = 0; tree < roots_.size(); ++tree) {
+    for (int i = 0; i < num_rows; ++i) {
+      scores[i] += leaf_scores_[GetLeaf(tree, float_values + static_cast<size_t>(i) * num_float_features_,
+                                        string_values + static_cast<size_t>(i) * num_string_features_)];
+    }
+  }
+}
+
+}  // namespace gbdt
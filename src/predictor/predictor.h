@@ -0,0 +1,120 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PREDICTOR_H_
+#define PREDICTOR_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/base/base.h"
+
+namespace gbdt {
+
+class Forest;
+class TreeNode;
+
+// Predictor scores raw feature vectors with a forest, without a DataStore, for
+// online scoring of a single row or a small batch.
+//
+// The schema names the float features and the string features of a row. A row
+// is given as float_values, indexed like float_features, with NAN for missing
+// values, and string_values, indexed like string_features, with nullptr for
+// missing values. A float split sends a value to the left child iff it is less
+// than the threshold, and a categorical split iff it is one of the categories.
+//
+// Scoring doesn't allocate, and the predictor is immutable once created, so it
+// can be shared by concurrent callers.
+class Predictor {
+ public:
+  // Fails if a feature of the forest is not in the schema, or is in the schema
+  // with a type that doesn't match its splits.
+  static Status Create(const Forest& forest,
+                       const vector<string>& float_features,
+                       const vector<string>& string_features,
+                       unique_ptr<Predictor>* predictor);
+
+  inline int num_trees() const {
+    return roots_.size();
+  }
+
+  // Returns the score of the row.
+  double Predict(const float* float_values, const char* const* string_values) const;
+
+  // Scores num_rows rows stored row by row, i.e. the values of row i start at
+  // float_values + i * float_features.size() and at
+  // string_values + i * string_features.size().
+  void PredictBatch(int num_rows, const float* float_values, const char* const* string_values,
+                    double* scores) const;
+
+ private:
+  struct Node {
+    // Index of the feature in the float or the string values.
+    int feature;
+    bool categorical;
+    bool missing_to_left;
+    float threshold;
+    // Range of the sorted categories of a categorical split in categories_.
+    int categories_begin;
+    int categories_end;
+    // Children, which are ~leaf for leaves.
+    int left_child;
+    int right_child;
+  };
+
+  Predictor(int num_float_features, int num_string_features)
+      : num_float_features_(num_float_features), num_string_features_(num_string_features) {}
+
+  // Returns the index of the node, or ~leaf for a leaf.
+  Status CompileNode(const TreeNode& node,
+                     const unordered_map<string, int>& float_indices,
+                     const unordered_map<string, int>& string_indices,
+                     int* index);
+  bool HasCategory(const Node& node, const char* value) const;
+
+  // Returns the leaf of the tree that the row falls in.
+  inline int GetLeaf(int tree, const float* float_values,
+                     const char* const* string_values) const {
+    int index = roots_[tree];
+    while (index >= 0) {
+      const auto& node = nodes_[index];
+      bool go_left;
+      if (node.categorical) {
+        const char* value = string_values[node.feature];
+        go_left = value != nullptr && HasCategory(node, value);
+      } else {
+        float value = float_values[node.feature];
+        go_left = std::isnan(value) ? node.missing_to_left : value < node.threshold;
+      }
+      index = go_left ? node.left_child : node.right_child;
+    }
+    return ~index;
+  }
+
+  int num_float_features_;
+  int num_string_features_;
+  // Root of each tree, which is ~leaf if the tree is a single leaf.
+  vector<int> roots_;
+  vector<Node> nodes_;
+  vector<string> categories_;
+  vector<double> leaf_scores_;
+};
+
+}  // namespace gbdt
+
+#endif  // PREDICTOR_H_
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <memory>
+#include <google/protobuf/text_format.h>
+
+#include "predictor.h"
+#include "gtest/gtest.h"
+#include "src/base/base.h"
+#include "src/data_store/column.h"
+#include "src/data_store/data_store.h"
+#include "src/gbdt_algo/compute_tree_scores.h"
+#include "src/proto/tree.pb.h"
+
+namespace gbdt {
+
+class PredictorTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    string text = "tree { score: 0.5 }"
+                  "tree {"
+                  "  split { feature: 'color' cat_split { category: ['red', 'green'] } }"
+                  "  left_child {"
+                  "    split { feature: 'length' float_split { threshold: 3.0 } }"
+                  "    left_child { "
+                  "      split { feature: 'width' float_split { threshold: 5.0 } } "
+                  "      left_child { score: 0.0 }"
+                  "      right_child { score: 1.0 }"
+                  "    }"
+                  "    right_child { score: 2.0 }"
+                  "  }"
+                  "  right_child { score: 3.0 }"
+                  "}"
+                  "tree {"
+                  "  split { feature: 'width' float_split { threshold: 4.5 "
+                  "                                         missing_to_right_child: true } }"
+                  "  left_child { score: 0.25 }"
+                  "  right_child {"
+                  "    split { feature: 'color' cat_split { category: ['blue'] } }"
+                  "    left_child { score: 0.125 }"
+                  "    right_child { score: 4.0 }"
+                  "  }"
+                  "}";
+    CHECK(google::protobuf::TextFormat::ParseFromString(text, &forest_));
+  }
+
+  Forest forest_;
+  const vector<string> colors_ =
+      {"red", "blue", "green", "blue", "red", "red", "blue", "green", "red", "blue"};
+  const vector<float> lengths_ = {2, 1, 1, 3, 2, 4, 10, 2, 7, 5};
+  const vector<float> widths_ = {2, 3, 7, 3, NAN, 4, 6, 2, NAN, 5};
+};
+
+TEST_F(PredictorTest, SameScoresAsComputeTreeScores) {
+  DataStore data_store;
+  data_store.Add(Column::CreateStringColumn("color", colors_));
+  data_store.Add(Column::CreateBucketizedFloatColumn("length", lengths_));
+  data_store.Add(Column::CreateBucketizedFloatColumn("width", widths_));
+  ComputeTreeScores compute_tree_scores(&data_store);
+  vector<double> expected_scores(data_store.num_rows(), 0.0);
+  for (const auto& tree : forest_.tree()) {
+    compute_tree_scores.AddTreeScores(tree, &expected_scores);
+  }
+
+  // The schema orders the features differently from the data store.
+  unique_ptr<Predictor> predictor;
+  EXPECT_TRUE(Predictor::Create(forest_, {"width", "length"}, {"color"}, &predictor).ok());
+  EXPECT_EQ(3, predictor->num_trees());
+
+  vector<float> float_values;
+  vector<const char*> string_values;
+  for (int i = 0; i < colors_.size(); ++i) {
+    float float_row[] = {widths_[i], lengths_[i]};
+    const char* string_row[] = {colors_[i].c_str()};
+    EXPECT_EQ(expected_scores[i], predictor->Predict(float_row, string_row)) << "Row " << i;
+    float_values.insert(float_values.end(), float_row, float_row + 2);
+    string_values.push_back(string_row[0]);
+  }
+
+  vector<double> scores(colors_.size());
+  predictor->PredictBatch(colors_.size(), float_values.data(), string_values.data(),
+                          scores.data());
+  EXPECT_EQ(expected_scores, scores);
+}
+
+TEST_F(PredictorTest, MissingAndUnknownValues) {
+  unique_ptr<Predictor> predictor;
+  EXPECT_TRUE(Predictor::Create(forest_, {"length", "width"}, {"color"}, &predictor).ok());
+
+  // A missing color goes to the right child of both categorical splits, and a
+  // missing width to the right child of the split on width of the last tree.
+  float float_row[] = {1, NAN};
+  const char* missing_color[] = {nullptr};
+  EXPECT_DOUBLE_EQ(0.5 + 3.0 + 4.0, predictor->Predict(float_row, missing_color));
+
+  // An unknown color goes the same way as a missing one.
+  const char* unknown_color[] = {"purple"};
+  EXPECT_DOUBLE_EQ(0.5 + 3.0 + 4.0, predictor->Predict(float_row, unknown_color));
+}
+
+TEST_F(PredictorTest, FeatureNotInSchema) {
+  unique_ptr<Predictor> predictor;
+  EXPECT_FALSE(Predictor::Create(forest_, {"length", "width"}, {}, &predictor).ok());
+  // The type of a feature in the schema must match its splits.
+  EXPECT_FALSE(Predictor::Create(forest_, {"length", "width", "color"}, {}, &predictor).ok());
+  EXPECT_FALSE(Predictor::Create(forest_, {"length"}, {"color", "width"}, &predictor).ok());
+  EXPECT_EQ(nullptr, predictor);
+}
+
+}  // namespace gbdt
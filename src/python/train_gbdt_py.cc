@@ -64,12 +64,13 @@ ForestPy TrainPy(DataStorePy* data_store,
                                       data_store->num_rows(), w.size())));
   }
 
-  FloatVector w_hat = [](int){ return 1.0f; };
+  // Unit weights if w is not given.
+  FloatVector w_hat;
   if (!w.empty()) {
-    w_hat = ([&w](int i) { return w[i]; });
+    w_hat = FloatVector(w);
   }
 
-  FloatVector y_hat = [&y](int i) { return y[i]; };
+  FloatVector y_hat(y);
   if (y.empty()) {
     if (config.target_column().empty()) {
       ThrowException(Status(error::INVALID_ARGUMENT,
@@ -80,8 +81,7 @@ ForestPy TrainPy(DataStorePy* data_store,
       ThrowException(Status(error::INVALID_ARGUMENT,
                             fmt::format("Failed to load target column {0}", config.target_column())));
     }
-    const vector<float>& target_floats = targets->raw_floats();
-    y_hat = [&target_floats](int i) { return target_floats[i]; };
+    y_hat = FloatVector(targets->raw_floats());
   }
 
 
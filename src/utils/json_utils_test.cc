@@ -40,7 +40,8 @@ class JsonUtilsTest : public ::testing::Test {
     right_child->mutable_right_child()->set_score(0);
 
     tree_json_ = "{\"score\":0.2,\"split\":{\"feature\":\"A\",\"floatSplit\":"
-                 "{\"threshold\":0,\"missingToRightChild\":false},\"gain\":0},\"leftChild\":"
+                 "{\"threshold\":0,\"missingToRightChild\":false,\"internalBucketThreshold\":0},"
+                 "\"gain\":0},\"leftChild\":"
                  "{\"score\":0},\"rightChild\":{\"score\":0.3,\"split\":"
                  "{\"feature\":\"B\",\"catSplit\":{\"category\":"
                  "[\"apple\",\"banana\"],\"internalCategoricalIndex\":[]},\"gain\":0},"
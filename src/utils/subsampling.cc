@@ -16,6 +16,7 @@
 
 #include "subsampling.h"
 
+#include <algorithm>
 #include <random>
 
 #include "src/utils/utils.h"
@@ -42,6 +43,40 @@ vector<uint> Subsampling::UniformSubsample(uint n, double rate) {
   return samples;
 }
 
+vector<uint> Subsampling::GossSubsample(const vector<double>& magnitudes,
+                                        double top_rate,
+                                        double other_rate,
+                                        vector<uint>* others) {
+  uint n = magnitudes.size();
+  uint num_top = min(n, static_cast<uint>(top_rate * n + 0.5));
+  // Finds the top rows in O(n). Ties are broken by the row, so that the top rows
+  // don't depend on the implementation of nth_element.
+  vector<uint> rows = CreateAllSamples(n);
+  if (num_top > 0 && num_top < n) {
+    nth_element(rows.begin(), rows.begin() + num_top, rows.end(), [&magnitudes](uint x, uint y) {
+        return magnitudes[x] > magnitudes[y] || (magnitudes[x] == magnitudes[y] && x < y);
+      });
+  }
+  vector<uint8> is_top(n, 0);
+  for (uint i = 0; i < num_top; ++i) {
+    is_top[rows[i]] = 1;
+  }
+
+  double rate = num_top < n ? other_rate * n / (n - num_top) : 0.0;
+  vector<uint> samples;
+  samples.reserve(num_top + static_cast<uint>(other_rate * n));
+  others->clear();
+  for (uint i = 0; i < n; ++i) {
+    if (is_top[i]) {
+      samples.emplace_back(i);
+    } else if (uniform_01_(generator_) < rate) {
+      samples.emplace_back(i);
+      others->emplace_back(i);
+    }
+  }
+  return samples;
+}
+
 vector<uint> Subsampling::CreateAllSamples(uint n) {
   vector<uint> samples(n);
   for (uint i = 0; i < n; ++i) {
@@ -34,6 +34,15 @@ public:
   // Construct the sample set [0,n-1]
   static vector<uint> CreateAllSamples(uint n);
   static vector<uint> UniformSubsample(uint n, double rate);
+  // Gradient-based one-side sampling (GOSS). Keeps the top_rate fraction of the
+  // rows with the largest magnitudes, and samples each of the other rows with
+  // probability other_rate / (1 - top_rate), so that about other_rate of all the
+  // rows are sampled from them. Returns the samples in ascending order. The
+  // sampled other rows are returned in others, also in ascending order.
+  static vector<uint> GossSubsample(const vector<double>& magnitudes,
+                                    double top_rate,
+                                    double other_rate,
+                                    vector<uint>* others);
 
   // Divide samples uniformly into gropus.
   static vector<VectorSlice<uint>> DivideSamples(VectorSlice<uint> samples, int num_groups);
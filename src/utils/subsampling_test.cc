@@ -16,6 +16,7 @@
 
 #include "subsampling.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -42,6 +43,25 @@ TEST(SubsamplingTest, UniformSubsampleSameSeed) {
   EXPECT_EQ(samples2, samples4);
 }
 
+TEST(SubsamplingTest, GossSubsample) {
+  Subsampling::Reseed(1234);
+  // Rows 990..999 have the largest magnitudes.
+  vector<double> magnitudes(1000);
+  for (int i = 0; i < magnitudes.size(); ++i) {
+    magnitudes[i] = i;
+  }
+  vector<uint> others;
+  auto samples = Subsampling::GossSubsample(magnitudes, 0.01, 0.5, &others);
+  EXPECT_TRUE(is_sorted(samples.begin(), samples.end()));
+  EXPECT_TRUE(is_sorted(others.begin(), others.end()));
+  for (uint i = 990; i < 1000; ++i) {
+    EXPECT_TRUE(binary_search(samples.begin(), samples.end(), i));
+    EXPECT_FALSE(binary_search(others.begin(), others.end(), i));
+  }
+  EXPECT_EQ(samples.size(), others.size() + 10);
+  EXPECT_NEAR(500, others.size(), 50);
+}
+
 TEST(SubsamplingTest, DivideSamples) {
   vector<uint> samples = {0, 1, 2, 3, 4, 5, 6, 7, 8};
   auto slices = Subsampling::DivideSamples(samples, 3);
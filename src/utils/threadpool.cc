@@ -15,6 +15,8 @@
 
 #include "threadpool.h"
 
+#include <algorithm>
+
 using namespace::std;
 
 ThreadPool::ThreadPool(int num_threads) {
@@ -34,6 +36,40 @@ void ThreadPool::Enqueue(std::function<void()> f) {
   condition_.notify_one();
 }
 
+ThreadPool* ThreadPool::Get(int num_threads) {
+  static mutex pool_mutex;
+  static unique_ptr<ThreadPool> pool;
+  num_threads = max(num_threads, 1);
+
+  lock_guard<mutex> lock(pool_mutex);
+  if (!pool || pool->num_threads() != num_threads) {
+    pool.reset(new ThreadPool(num_threads));
+  }
+  return pool.get();
+}
+
+void ThreadPool::ParallelFor(int n, const function<void(int)>& f) {
+  TaskGroup group(this);
+  for (int i = 0; i < n; ++i) {
+    group.Run([&f, i]() { f(i); });
+  }
+  group.Wait();
+}
+
+bool ThreadPool::RunPendingTask() {
+  function<void()> task;
+  {
+    unique_lock<mutex> lock(queue_mutex_);
+    if (tasks_.empty()) {
+      return false;
+    }
+    task = std::move(tasks_.front());
+    tasks_.pop();
+  }
+  task();
+  return true;
+}
+
 void ThreadPool::Invoke() {
   while(true) {
     function<void()> task;
@@ -80,3 +116,40 @@ void ThreadPool::ShutDown() {
 ThreadPool::~ThreadPool() {
   ShutDown();
 }
+
+TaskGroup::~TaskGroup() {
+  Wait();
+}
+
+void TaskGroup::Run(function<void()> f) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++num_pending_tasks_;
+  }
+  pool_->Enqueue([this, f=std::move(f)]() {
+      f();
+      Finish();
+    });
+}
+
+void TaskGroup::Finish() {
+  lock_guard<mutex> lock(mutex_);
+  if (--num_pending_tasks_ == 0) {
+    done_.notify_all();
+  }
+}
+
+void TaskGroup::Wait() {
+  while (true) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (num_pending_tasks_ == 0) return;
+    }
+    // Help with the queued tasks instead of blocking a thread of the pool.
+    if (!pool_->RunPendingTask()) {
+      unique_lock<mutex> lock(mutex_);
+      done_.wait(lock, [this] { return num_pending_tasks_ == 0; });
+      return;
+    }
+  }
+}
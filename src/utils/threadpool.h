@@ -13,8 +13,12 @@
  * limitations under the License.
  */
 
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <queue>
@@ -28,10 +32,27 @@ public:
 
   void Enqueue(std::function<void()> f);
 
+  // Returns the process-wide pool. The pool is created on the first call and
+  // recreated when num_threads changes. Reusing the pool avoids spawning and
+  // joining threads on every parallel section.
+  static ThreadPool* Get(int num_threads);
+
+  int num_threads() const {
+    return thread_pool_.size();
+  }
+
+  // Runs f(i) for i in [0, n) and blocks until all of them finish.
+  void ParallelFor(int n, const std::function<void(int)>& f);
+
 private:
+  friend class TaskGroup;
+
   // Function that will be invoked by our threads.
   void Invoke();
   void ShutDown();
+  // Runs one task from the queue in the calling thread. Returns false if the
+  // queue is empty.
+  bool RunPendingTask();
 
   std::vector<std::thread> thread_pool_;
 
@@ -44,3 +65,26 @@ private:
   // Indicates that pool needs to be shut down.
   bool to_be_shutdown_ = false;
 };
+
+// TaskGroup is a batch of tasks running on a pool that can be waited on.
+// While waiting, the calling thread runs queued tasks itself, so groups can be
+// nested inside tasks of the same pool without deadlocks.
+class TaskGroup {
+public:
+  TaskGroup(ThreadPool* pool) : pool_(pool) {}
+  // Waits for all tasks to finish.
+  ~TaskGroup();
+
+  void Run(std::function<void()> f);
+  void Wait();
+
+private:
+  void Finish();
+
+  ThreadPool* pool_;
+  int num_pending_tasks_ = 0;
+  std::mutex mutex_;
+  std::condition_variable done_;
+};
+
+#endif  // THREADPOOL_H_
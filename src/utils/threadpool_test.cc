@@ -0,0 +1,52 @@
+/*
+ * Copyright 2016 Jiang Chen <criver@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "threadpool.h"
+
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(ThreadPoolTest, ParallelFor) {
+  std::vector<int> values(1000, 0);
+  ThreadPool::Get(4)->ParallelFor(values.size(), [&](int i) { values[i] = i; });
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(i, values[i]);
+  }
+}
+
+TEST(ThreadPoolTest, GetReusesPool) {
+  ThreadPool* pool = ThreadPool::Get(4);
+  EXPECT_EQ(pool, ThreadPool::Get(4));
+  EXPECT_EQ(4, pool->num_threads());
+  EXPECT_EQ(2, ThreadPool::Get(2)->num_threads());
+}
+
+TEST(ThreadPoolTest, NestedTaskGroups) {
+  // Nested groups must not deadlock even when there are more outer tasks than threads.
+  ThreadPool* pool = ThreadPool::Get(2);
+  std::atomic<int> count(0);
+  TaskGroup group(pool);
+  for (int i = 0; i < 8; ++i) {
+    group.Run([pool, &count]() {
+        pool->ParallelFor(10, [&count](int) { ++count; });
+      });
+  }
+  group.Wait();
+  EXPECT_EQ(80, count.load());
+}